@@ -0,0 +1,78 @@
+/*
+ * Template of the vmm_translate_batch loop for one geometry, included by
+ * vmm.c once per variant. Before each inclusion it defines:
+ *   BATCH_NAME       the name of the function
+ *   BATCH_PAGE_BITS  log2 of the page size
+ *   BATCH_TLB_SIZE   entries in the TLB(a multiple of 4, at most 64)
+ *   BATCH_PROFILE    1 if the instance keeps a page profile, 0 if not
+ * With those known at compile time the address decodes to a constant shift
+ * and mask, and the TLB scan is a fixed run of 4-wide compares(SSE2, or
+ * scalar elsewhere) that is fully unrolled, with one branch at the end. A tag
+ * is held at most once, so the first match is the only one. TLB hits and page
+ * table hits(which fill the TLB) are made here; only faults go through
+ * vmm_access. A variant is only picked for an instance that does no sampling
+ * or deduplication on an access, so both paths make exactly the updates that
+ * vmm_access would.
+ */
+static void BATCH_NAME(VMM_CTX *ctx, const unsigned int *vaddrs, size_t count,
+        unsigned int *paddrs, signed char *values) {
+    const int32_t *tags = tagsTLB(ctx->tlbs[0]);
+    const int *frames = framesTLB(ctx->tlbs[0]);
+    for(size_t i=0; i<count; i++) {
+        if(i + 2*BATCH_PREFETCH < count)
+            prefetchPageTable(ctx, vaddrs[i + 2*BATCH_PREFETCH]);
+        if(i + BATCH_PREFETCH < count)
+            prefetchPage(ctx, vaddrs[i + BATCH_PREFETCH]);
+        unsigned int vaddr = vaddrs[i];
+        int32_t pageNum = (int32_t)(vaddr >> BATCH_PAGE_BITS);
+        unsigned int offset = vaddr & ((1u << BATCH_PAGE_BITS) - 1);
+#ifdef __SSE2__
+        __m128i key = _mm_set1_epi32(pageNum);
+        uint64_t hits = 0;
+#pragma GCC unroll 16
+        for(int e=0; e<BATCH_TLB_SIZE; e+=4) {
+            __m128i eq = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i *)(tags + e)), key);
+            hits |= (uint64_t)_mm_movemask_ps(_mm_castsi128_ps(eq)) << e;
+        }
+        int frame = hits != 0 ? frames[__builtin_ctzll(hits)] : -1;
+#else
+        int frame = -1;
+#pragma GCC unroll 64
+        for(int e=0; e<BATCH_TLB_SIZE; e++)
+            frame = tags[e] == pageNum ? frames[e] : frame;
+#endif
+        int tlbHit = frame != -1;
+        if(!tlbHit) {
+            frame = getFrameNumber(ctx->pageTables[0], pageNum);
+            if(frame == -1) {   //A fault
+                vmm_access(ctx, 0, vaddr, 0, values ? &values[i] : NULL, &paddrs[i]);
+                continue;
+            }
+        }
+
+        ctx->cpu = 0;
+        ctx->stats.pageAccesses++;
+        ctx->stats.tlbLookups++;
+        ctx->cpuStats[0].references++;
+        ctx->cpuStats[0].tlbLookups++;
+        if(tlbHit) {
+            ctx->stats.tlbHits++;
+            ctx->cpuStats[0].tlbHits++;
+        } else {
+            addTLBEntry(ctx, 0, pageNum, frame);
+        }
+#if BATCH_PROFILE
+        profileAccess(ctx, pageNum);
+#endif
+        PAGE *page = touchFrame(ctx, frame);
+        if(values)
+            values[i] = page != NULL ? page->content[offset] : 0;
+        paddrs[i] = ((unsigned int)frame << BATCH_PAGE_BITS) | offset;
+        accountAccess(ctx, frame, 0, 1);   //CPU 0 and process 0 are both on node 0
+    }
+}
+
+#undef BATCH_NAME
+#undef BATCH_PAGE_BITS
+#undef BATCH_TLB_SIZE
+#undef BATCH_PROFILE
@@ -37,6 +37,13 @@ DLL *newDLL(void (*d)(void *,FILE *), void (*f)(void *)) {
     return list;
 }
 void insertDLL(DLL *items, int index, void *value) {
+    insertNodeDLL(items, index, value);
+}
+/*
+ * Same as insertDLL, but returns the new node so that it can later be moved or
+ * removed without searching for it.
+ */
+DLL_NODE *insertNodeDLL(DLL *items, int index, void *value) {
     assert(index >= 0 && index <= items->size);
     NODE *item = newNODE(value);
     if(items->size == 0) {
@@ -74,6 +81,7 @@ void insertDLL(DLL *items, int index, void *value) {
         if(index == items->size-1)
             items->tail = item;
     }
+    return item;
 }
 void *removeDLL(DLL *items, int index) {
     assert(items->size > 0);
@@ -103,6 +111,41 @@ void *removeDLL(DLL *items, int index) {
     free(item);
     return temp;
 }
+/*
+ * Unlinks the given node from the list and frees it, returning its value.
+ */
+void *removeNodeDLL(DLL *items, DLL_NODE *node) {
+    assert(items->size > 0);
+    node->prev->next = node->next;
+    node->next->prev = node->prev;
+    if(node == items->head)
+        items->head = node->next;
+    if(node == items->tail)
+        items->tail = node->prev;
+    if(--items->size == 0) {
+        items->head = NULL;
+        items->tail = NULL;
+    }
+    void *temp = node->value;
+    free(node);
+    return temp;
+}
+/*
+ * Moves the given node to the front of the list(index 0).
+ */
+void frontNodeDLL(DLL *items, DLL_NODE *node) {
+    if(node == items->head)
+        return;
+    if(node == items->tail)
+        items->tail = node->prev;
+    node->prev->next = node->next;
+    node->next->prev = node->prev;
+    node->next = items->head;
+    node->prev = items->tail;
+    items->head->prev = node;
+    items->tail->next = node;
+    items->head = node;
+}
 void unionDLL(DLL *recipient, DLL *donor) {
     if(recipient->size != 0 && donor->size != 0) {
         recipient->tail->next = donor->head;
@@ -129,12 +172,24 @@ void *getDLL(DLL *items, int index) {
         }
     } else {
         item = items->tail;
-        for(int i=items->size-1; i>items->size; i--) {
+        for(int i=items->size-1; i>index; i--) {
             item = item->prev;
         }
     }
     return item->value;
 }
+/*
+ * Walks the list from head to tail: returns the head when node is NULL, the
+ * node after it otherwise, and NULL past the tail.
+ */
+DLL_NODE *nextNodeDLL(DLL *items, DLL_NODE *node) {
+    if(node == NULL)
+        return items->head;
+    return node == items->tail ? NULL : node->next;
+}
+void *valueNodeDLL(DLL_NODE *node) {
+    return node->value;
+}
 void *setDLL(DLL *items, int index, void *value) {
     assert(index >= 0 && index < items->size);
     NODE *item;
@@ -145,7 +200,7 @@ void *setDLL(DLL *items, int index, void *value) {
         }
     } else {
         item = items->tail;
-        for(int i=items->size-1; i>items->size; i--) {
+        for(int i=items->size-1; i>index; i--) {
             item = item->prev;
         }
     }
@@ -180,12 +235,13 @@ void displayDLL(DLL *items, FILE *fp) {
     }
 }
 void freeDLL(DLL *items) {
-    NODE *item = items->head, *next = item->next;
+    NODE *item = items->head, *next;
     for(int i=0; i<items->size; i++) {
-        items->free(item->value);
+        next = item->next;
+        if(items->free)
+            items->free(item->value);
         free(item);
         item = next;
-        if(next)
-            next = next->next;
     }
+    free(items);
 }
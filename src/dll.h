@@ -4,12 +4,18 @@
 #include <stdio.h>
 
 typedef struct dll DLL;
+typedef struct node DLL_NODE;
 
 extern DLL *newDLL(void (*d)(void *,FILE *),void (*f)(void *)); 
 extern void insertDLL(DLL *items,int index,void *value);
 extern void *removeDLL(DLL *items,int index);
+extern DLL_NODE *insertNodeDLL(DLL *items,int index,void *value);
+extern void *removeNodeDLL(DLL *items,DLL_NODE *node);
+extern void frontNodeDLL(DLL *items,DLL_NODE *node);
 extern void unionDLL(DLL *recipient,DLL *donor);
 extern void *getDLL(DLL *items,int index);
+extern DLL_NODE *nextNodeDLL(DLL *items,DLL_NODE *node);
+extern void *valueNodeDLL(DLL_NODE *node);
 extern void *setDLL(DLL *items,int index,void *value);
 extern int findDLL(DLL *items, void *value);
 extern int sizeDLL(DLL *items);
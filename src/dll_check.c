@@ -0,0 +1,89 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "dll.h"
+
+#define SIZE 9
+
+static int freed = 0;
+
+static void countFree(void *v) {
+    (void)v;
+    freed++;
+}
+
+/*
+ * Checks the doubly linked list against a plain array: indexed reads and
+ * writes from both ends(indices past the middle walk back from the tail),
+ * removal, moving a node to the front, walking by node, and freeing with and
+ * without a free function. Prints what fails and exits non-zero if anything
+ * does.
+ */
+int main(void) {
+    int values[SIZE], expect[SIZE], errors = 0;
+    DLL *list = newDLL(NULL, &countFree);
+    for(int i=0; i<SIZE; i++) {
+        values[i] = i;
+        expect[i] = i;
+        insertDLL(list, i, &values[i]);
+    }
+    for(int i=0; i<SIZE; i++) {
+        if(*(int *)getDLL(list, i) != expect[i]) {
+            fprintf(stderr, "getDLL(%d) gave %d, expected %d.\n", i, *(int *)getDLL(list, i), expect[i]);
+            errors++;
+        }
+    }
+
+    int replaced[SIZE];
+    for(int i=0; i<SIZE; i++) {     //Reverses the list through setDLL
+        replaced[i] = SIZE - 1 - i;
+        int *old = setDLL(list, i, &replaced[i]);
+        if(*old != i) {
+            fprintf(stderr, "setDLL(%d) replaced %d, expected %d.\n", i, *old, i);
+            errors++;
+        }
+    }
+    for(int i=0; i<SIZE; i++) {
+        if(*(int *)getDLL(list, i) != SIZE - 1 - i) {
+            fprintf(stderr, "After setDLL, index %d holds %d, expected %d.\n", i, *(int *)getDLL(list, i), SIZE - 1 - i);
+            errors++;
+        }
+    }
+
+    int *removed = removeDLL(list, SIZE - 2);   //Past the middle, so found from the tail
+    if(*removed != 1 || sizeDLL(list) != SIZE - 1 || *(int *)getDLL(list, SIZE - 2) != 0) {
+        fprintf(stderr, "removeDLL(%d) gave %d and left the list wrong.\n", SIZE - 2, *removed);
+        errors++;
+    }
+
+    DLL_NODE *last = NULL;
+    int steps = 0;
+    for(DLL_NODE *n = nextNodeDLL(list, NULL); n != NULL && steps <= SIZE; n = nextNodeDLL(list, n), steps++)
+        last = n;   //Bounded in case the links are broken
+    frontNodeDLL(list, last);
+    int count = 0, previous = -1;
+    for(DLL_NODE *n = nextNodeDLL(list, NULL); n != NULL && count <= SIZE; n = nextNodeDLL(list, n), count++) {
+        int v = *(int *)valueNodeDLL(n);
+        if(count == 0 ? v != 0 : count > 1 && v != previous - 1) {
+            fprintf(stderr, "Walking the list after frontNodeDLL gave %d at %d.\n", v, count);
+            errors++;
+        }
+        previous = v;
+    }
+    if(count != SIZE - 1) {
+        fprintf(stderr, "Walking the list visited %d nodes, expected %d.\n", count, SIZE - 1);
+        errors++;
+    }
+
+    freeDLL(list);
+    if(freed != SIZE - 1) {
+        fprintf(stderr, "freeDLL freed %d values, expected %d.\n", freed, SIZE - 1);
+        errors++;
+    }
+    DLL *plain = newDLL(NULL, NULL);    //Without a free function
+    insertDLL(plain, 0, &values[0]);
+    freeDLL(plain);
+
+    if(errors == 0)
+        printf("DLL checks passed.\n");
+    return errors != 0;
+}
@@ -0,0 +1,137 @@
+#define _POSIX_C_SOURCE 200809L  //For getopt
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "eventlog.h"
+
+#define READ_RECORDS 4096
+
+/*
+ * An event with its place in the file, which breaks ties when sorting.
+ */
+typedef struct read_event {
+    EVENT event;
+    size_t index;
+} READ_EVENT;
+
+static int compareEvents(const void *a, const void *b);
+static void printEvent(FILE *out, const EVENT *e, int numPages, int csv);
+
+/*
+ * Turns a binary event log written by lru -e(see eventlog.h) into one line
+ * of text, or CSV with -c, per event. The log holds each CPU's events in
+ * blocks; -s sorts them into the order the references were made in, which
+ * needs the whole log in memory. A count of each type goes to stderr.
+ */
+int main(int argc, char **argv) {
+    int csv = 0, sorted = 0;
+    int opt;
+    while((opt = getopt(argc, argv, "cs")) != -1) {
+        switch(opt) {
+        case 'c':   //CSV instead of text
+            csv = 1;
+            break;
+        case 's':   //Sort by reference
+            sorted = 1;
+            break;
+        default:
+            argc = -1;  //Forces the usage message below
+        }
+    }
+    if(argc - optind != 1) {
+        fprintf(stderr, "Incorrect usage of parameters. Correct usage: %s [-c] [-s] <event_log>\n", argv[0]);
+        return -1;
+    }
+    FILE *fp = fopen(argv[optind], "rb");
+    if(fp == NULL) {
+        fprintf(stderr, "File could not be read from.\n");
+        return -2;
+    }
+    EVENT_HEADER header;
+    if(fread(&header, sizeof(header), 1, fp) != 1 || memcmp(header.magic, EVENT_MAGIC, sizeof(EVENT_MAGIC)) != 0
+            || header.recordSize != (int32_t)sizeof(EVENT) || header.numPages <= 0) {
+        fprintf(stderr, "%s is not an event log.\n", argv[optind]);
+        fclose(fp);
+        return -2;
+    }
+
+    long counts[EVENT_TYPES] = {0};
+    if(csv)
+        printf("ref,cpu,event,asid,page,frame,victim\n");
+    READ_EVENT *events = NULL;
+    size_t count = 0, capacity = 0;
+    EVENT block[READ_RECORDS];
+    size_t n;
+    while((n = fread(block, sizeof(EVENT), READ_RECORDS, fp)) > 0) {
+        for(size_t i=0; i<n; i++)
+            counts[block[i].type < EVENT_TYPES ? block[i].type : 0]++;
+        if(!sorted) {
+            for(size_t i=0; i<n; i++)
+                printEvent(stdout, &block[i], header.numPages, csv);
+            continue;
+        }
+        if(count + n > capacity) {
+            capacity = capacity * 2 + n;
+            events = realloc(events, sizeof(READ_EVENT) * capacity);
+            if(events == NULL) {
+                fprintf(stderr, "Could not hold %zu events to sort them.\n", capacity);
+                fclose(fp);
+                return -3;
+            }
+        }
+        for(size_t i=0; i<n; i++, count++) {
+            events[count].event = block[i];
+            events[count].index = count;
+        }
+    }
+    fclose(fp);
+    if(sorted) {
+        qsort(events, count, sizeof(READ_EVENT), &compareEvents);
+        for(size_t i=0; i<count; i++)
+            printEvent(stdout, &events[i].event, header.numPages, csv);
+        free(events);
+    }
+
+    for(int t=1; t<EVENT_TYPES; t++)
+        fprintf(stderr, "%s%s = %ld", t > 1 ? ", " : "", nameEvent(t), counts[t]);
+    fprintf(stderr, "\n");
+    return 0;
+}
+/*
+ * Orders events by reference. Every event of a reference is logged by the
+ * CPU that made it, so ties keep the order they were read in.
+ */
+static int compareEvents(const void *a, const void *b) {
+    const READ_EVENT *x = a, *y = b;
+    if(x->event.ref != y->event.ref)
+        return x->event.ref < y->event.ref ? -1 : 1;
+    return x->index < y->index ? -1 : (x->index > y->index);
+}
+/*
+ * Prints one event. Pages are shown as asid:page; what the victim is depends
+ * on the type of event.
+ */
+static void printEvent(FILE *out, const EVENT *e, int numPages, int csv) {
+    int asid = e->page >= 0 ? e->page / numPages : -1, page = e->page >= 0 ? e->page % numPages : -1;
+    if(csv) {
+        fprintf(out, "%lld,%d,%s,%d,%d,%d,%d\n", (long long)e->ref, e->cpu, nameEvent(e->type), asid, page, e->frame, e->victim);
+        return;
+    }
+    fprintf(out, "%10lld cpu %d %-9s %d:%d frame %d", (long long)e->ref, e->cpu, nameEvent(e->type), asid, page, e->frame);
+    switch(e->type) {
+    case EVENT_FAULT:
+    case EVENT_TLB_FILL:
+        if(e->victim >= 0)
+            fprintf(out, " victim %d:%d", e->victim / numPages, e->victim % numPages);
+        break;
+    case EVENT_SHOOTDOWN:
+        fprintf(out, " ipis %d", e->victim);
+        break;
+    case EVENT_EVICT:
+        break;
+    default:
+        fprintf(out, " from frame %d", e->victim);
+    }
+    fputc('\n', out);
+}
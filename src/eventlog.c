@@ -0,0 +1,161 @@
+#define _POSIX_C_SOURCE 200809L  //For nanosleep and sched_yield
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <time.h>
+#include <sched.h>
+#include <pthread.h>
+#include "eventlog.h"
+
+#define RING_SIZE (1 << 14)     //Records in each ring(a power of two)
+#define WRITER_SLEEP_NS 200000  //How long the writer waits when every ring is empty
+#define CACHE_LINE 64
+
+/*
+ * A single-producer single-consumer ring. head is only written by the CPU's
+ * thread and tail only by the writer, each publishing the records before it
+ * with a release store. They sit on separate cache lines so the two threads
+ * do not fight over one.
+ */
+typedef struct event_ring {
+    EVENT records[RING_SIZE];
+    unsigned long head;         //Records ever appended
+    char pad[CACHE_LINE - sizeof(unsigned long)];
+    unsigned long tail;         //Records ever written out
+} EVENT_RING;
+
+struct event_log {
+    FILE *fp;
+    int numCPUs;
+    EVENT_RING *rings;          //One per CPU
+    pthread_t writer;
+    int stop;                   //Set when the log is being closed
+    long written;
+    int error;
+};
+
+static void *runWriter(void *arg);
+static int drainRings(EVENT_LOG *log);
+
+static const char *EVENT_NAMES[EVENT_TYPES] = {
+    "?", "fault", "evict", "tlb-fill", "shootdown", "cow", "merge", "migrate", "demote", "promote"
+};
+
+/*
+ * Creates the log file, writes its header and starts the background writer.
+ * Returns NULL if the file could not be created.
+ */
+EVENT_LOG *newEventLog(const char *path, int numCPUs, int numPages) {
+    FILE *fp = fopen(path, "wb");
+    if(fp == NULL) {
+        fprintf(stderr, "Event log %s could not be written to.\n", path);
+        return NULL;
+    }
+    EVENT_HEADER header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, EVENT_MAGIC, sizeof(EVENT_MAGIC));
+    header.recordSize = sizeof(EVENT);
+    header.numCPUs = numCPUs;
+    header.numPages = numPages;
+    fwrite(&header, sizeof(header), 1, fp);
+
+    EVENT_LOG *log = malloc(sizeof(EVENT_LOG));
+    assert(log != 0);
+    log->fp = fp;
+    log->numCPUs = numCPUs;
+    log->rings = calloc(numCPUs, sizeof(EVENT_RING));
+    assert(log->rings != 0);
+    log->stop = 0;
+    log->written = 0;
+    log->error = 0;
+    if(pthread_create(&log->writer, NULL, &runWriter, log) != 0) {
+        fprintf(stderr, "The event log writer could not be started.\n");
+        fclose(fp);
+        free(log->rings);
+        free(log);
+        return NULL;
+    }
+    return log;
+}
+/*
+ * Appends an event to the given CPU's ring. Only that CPU's thread may call
+ * this. If the writer has fallen a whole ring behind, the thread yields
+ * until it catches up rather than lose the event.
+ */
+void logEvent(EVENT_LOG *log, int cpu, long ref, int type, int page, int frame, int victim) {
+    EVENT_RING *ring = &log->rings[cpu];
+    unsigned long head = ring->head;
+    while(head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) >= RING_SIZE)
+        sched_yield();
+    EVENT *e = &ring->records[head & (RING_SIZE - 1)];
+    e->ref = ref;
+    e->type = (uint8_t)type;
+    e->cpu = (uint8_t)cpu;
+    e->reserved = 0;
+    e->page = page;
+    e->frame = frame;
+    e->victim = victim;
+    __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+}
+/*
+ * Stops the writer once it has written out every event logged so far, and
+ * closes the file.
+ * Returns the number of events written, or -1 if the file could not be.
+ */
+long freeEventLog(EVENT_LOG *log) {
+    __atomic_store_n(&log->stop, 1, __ATOMIC_RELEASE);
+    pthread_join(log->writer, NULL);
+    if(fclose(log->fp) != 0)
+        log->error = 1;
+    long written = log->error ? -1 : log->written;
+    free(log->rings);
+    free(log);
+    return written;
+}
+/*
+ * Returns the name of the given type of event.
+ */
+const char *nameEvent(int type) {
+    return type > 0 && type < EVENT_TYPES ? EVENT_NAMES[type] : EVENT_NAMES[0];
+}
+
+/*
+ * The background writer: drains the rings until the log is closed, sleeping
+ * whenever they are all empty.
+ */
+static void *runWriter(void *arg) {
+    EVENT_LOG *log = arg;
+    struct timespec pause = {0, WRITER_SLEEP_NS};
+    while(!__atomic_load_n(&log->stop, __ATOMIC_ACQUIRE)) {
+        if(drainRings(log) == 0)
+            nanosleep(&pause, NULL);
+    }
+    drainRings(log);    //Whatever was logged before the close
+    return NULL;
+}
+/*
+ * Writes out every record appended to the rings so far.
+ * Returns the number of records written.
+ */
+static int drainRings(EVENT_LOG *log) {
+    int drained = 0;
+    for(int c=0; c<log->numCPUs; c++) {
+        EVENT_RING *ring = &log->rings[c];
+        unsigned long tail = ring->tail;
+        unsigned long head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+        while(tail != head) {   //At most two pieces, either side of the wrap
+            unsigned long start = tail & (RING_SIZE - 1);
+            unsigned long count = head - tail;
+            if(count > RING_SIZE - start)
+                count = RING_SIZE - start;
+            if(fwrite(&ring->records[start], sizeof(EVENT), count, log->fp) != count)
+                log->error = 1;
+            tail += count;
+            drained += (int)count;
+        }
+        __atomic_store_n(&ring->tail, tail, __ATOMIC_RELEASE);
+    }
+    log->written += drained;
+    return drained;
+}
@@ -0,0 +1,54 @@
+#ifndef EVENTLOG_H
+#define EVENTLOG_H
+
+#include <stdint.h>
+
+/*
+ * A binary log of the simulator's events. Each simulated CPU(one thread in
+ * lru) appends fixed-size records to a ring of its own without taking any
+ * lock, and a background thread drains the rings into the file. Records are
+ * written in host byte order after an EVENT_HEADER. Within one CPU they are
+ * in the order they happened; every event is stamped with the number of the
+ * reference that caused it, which orders them across CPUs.
+ */
+typedef struct event_log EVENT_LOG;
+
+#define EVENT_MAGIC "VMMEVT1"
+#define EVENT_FAULT 1       //page was loaded into frame, taking it from victim(a page, or -1)
+#define EVENT_EVICT 2       //page was swapped out of frame
+#define EVENT_TLB_FILL 3    //page was cached in a TLB, replacing victim(a page, or -1)
+#define EVENT_SHOOTDOWN 4   //page was remapped to frame(-1 to unmap it), costing victim IPIs
+#define EVENT_COW 5         //page got a private copy in frame of the shared frame victim
+#define EVENT_MERGE 6       //page was merged into frame, freeing the identical frame victim
+#define EVENT_MIGRATE 7     //page moved from frame victim to frame on another NUMA node
+#define EVENT_DEMOTE 8      //page moved from fast frame victim to slow frame
+#define EVENT_PROMOTE 9     //page moved from slow frame victim to fast frame
+#define EVENT_TYPES 10
+
+/*
+ * Pages are numbered across every address space(asid * numPages + page).
+ */
+typedef struct event {
+    int64_t ref;            //Number of the reference that caused the event, counting from 1
+    uint8_t type;
+    uint8_t cpu;
+    uint16_t reserved;
+    int32_t page;
+    int32_t frame;
+    int32_t victim;
+} EVENT;
+
+typedef struct event_header {
+    char magic[8];
+    int32_t recordSize;     //sizeof(EVENT)
+    int32_t numCPUs;
+    int32_t numPages;       //Pages in each address space
+    int32_t reserved;
+} EVENT_HEADER;
+
+extern EVENT_LOG *newEventLog(const char *path, int numCPUs, int numPages);
+extern void logEvent(EVENT_LOG *log, int cpu, long ref, int type, int page, int frame, int victim);
+extern long freeEventLog(EVENT_LOG *log);
+extern const char *nameEvent(int type);
+
+#endif
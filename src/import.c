@@ -0,0 +1,473 @@
+#define _POSIX_C_SOURCE 200809L  //For dup and strncasecmp
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <limits.h>
+#include <unistd.h>
+#include <assert.h>
+#include <zlib.h>       //Reads plain and gzip'd input alike
+#include "import.h"
+
+#define LINE_SIZE 4096              //Lines this long or longer are skipped(and counted as malformed)
+#define READ_BUFFER (1 << 18)       //Bytes read from the input at a time
+#define MAX_FIELDS 64               //Whitespace or comma separated fields looked at per line
+#define LACKEY_UNKNOWN -2           //No "==pid==" line read yet
+#define LACKEY_NO_PID 0             //Stands in for the pid of references before any "==pid==" line
+
+struct importer {
+    gzFile in;
+    int format, flags;
+    char *buffer;                   //READ_BUFFER bytes of input, split into lines in place
+    size_t start, end;              //Unread part of buffer
+    int eof;
+    char *line;                     //Line being parsed, within buffer
+    TRACE_REF pending;              //Second half of a Lackey modify
+    int hasPending;
+    int lackeyProcess;              //Process of the Lackey run being read(-1 if dropped, LACKEY_UNKNOWN before its pid is seen)
+    int addressColumn, rwColumn, pidColumn, sawHeader;     //CSV layout
+    long *pids;                     //Open addressing table of pid -> process
+    int *asids;
+    int tableSize, maxProcesses, numProcesses;
+    IMPORT_STATS stats;
+};
+
+static int readLine(IMPORTER *im);
+static int parseLackey(IMPORTER *im, TRACE_REF *ref);
+static int parsePerf(IMPORTER *im, TRACE_REF *ref);
+static int parseCSV(IMPORTER *im, TRACE_REF *ref);
+static int splitFields(char *line, char separator, char **fields);
+static int containsWord(const char *s, const char *word);
+static int parseAddress(const char *s, int hex, unsigned int *vaddr);
+static int lookupProcess(IMPORTER *im, long pid);
+
+/*
+ * Returns the IMPORT_* format with the given name, or -1 if there is none.
+ */
+int formatImport(const char *name) {
+    if(strcmp(name, "lackey") == 0)
+        return IMPORT_LACKEY;
+    if(strcmp(name, "perf") == 0)
+        return IMPORT_PERF;
+    if(strcmp(name, "csv") == 0)
+        return IMPORT_CSV;
+    return -1;
+}
+/*
+ * Opens a trace of the given format. At most maxProcesses processes are
+ * kept; references made by any others are dropped.
+ * Returns NULL if the input could not be opened.
+ */
+IMPORTER *newImporter(const char *path, int format, int maxProcesses, int flags) {
+    gzFile in = strcmp(path, "-") == 0 ? gzdopen(dup(STDIN_FILENO), "rb") : gzopen(path, "rb");
+    if(in == NULL) {
+        fprintf(stderr, "Trace %s could not be read from.\n", path);
+        return NULL;
+    }
+    gzbuffer(in, READ_BUFFER);
+
+    IMPORTER *im = malloc(sizeof(IMPORTER));
+    assert(im != 0);
+    im->in = in;
+    im->buffer = malloc(READ_BUFFER + 1);
+    assert(im->buffer != 0);
+    im->start = im->end = 0;
+    im->eof = 0;
+    im->line = im->buffer;
+    im->format = format;
+    im->flags = flags;
+    im->hasPending = 0;
+    im->lackeyProcess = LACKEY_UNKNOWN;
+    im->addressColumn = 0;
+    im->rwColumn = 1;
+    im->pidColumn = 2;
+    im->sawHeader = 0;
+    im->maxProcesses = maxProcesses > 0 ? maxProcesses : 1;
+    im->tableSize = 1;
+    while(im->tableSize < 2 * im->maxProcesses)
+        im->tableSize *= 2;
+    im->pids = malloc(sizeof(long) * im->tableSize);
+    im->asids = malloc(sizeof(int) * im->tableSize);
+    assert(im->pids != 0 && im->asids != 0);
+    for(int i=0; i<im->tableSize; i++)
+        im->asids[i] = -1;
+    im->numProcesses = 0;
+    memset(&im->stats, 0, sizeof(IMPORT_STATS));
+    return im;
+}
+/*
+ * Reads the next reference of the trace into ref, skipping lines that hold
+ * none(headers, comments, other events) and lines that cannot be parsed.
+ * Returns 1 if a reference was read, or 0 at EOF.
+ */
+int nextImported(IMPORTER *im, TRACE_REF *ref) {
+    if(im->hasPending) {
+        *ref = im->pending;
+        im->hasPending = 0;
+        im->stats.references++;
+        return 1;
+    }
+    while(readLine(im)) {
+        int rc;
+        if(im->format == IMPORT_LACKEY)
+            rc = parseLackey(im, ref);
+        else if(im->format == IMPORT_PERF)
+            rc = parsePerf(im, ref);
+        else
+            rc = parseCSV(im, ref);
+        if(rc == 1) {
+            im->stats.references++;
+            return 1;
+        }
+        if(rc == -1)
+            im->stats.malformed++;
+    }
+    return 0;
+}
+void statsImport(const IMPORTER *im, IMPORT_STATS *stats) {
+    *stats = im->stats;
+}
+void freeImporter(IMPORTER *im) {
+    gzclose(im->in);
+    free(im->buffer);
+    free(im->pids);
+    free(im->asids);
+    free(im);
+}
+
+/*
+ * Points im->line at the next line of input, without its newline. The input
+ * is read a buffer at a time and split in place, so nothing is copied. Lines
+ * of LINE_SIZE bytes or more are skipped and counted as malformed, wherever
+ * they fall in the buffer.
+ * Returns 0 at EOF.
+ */
+static int readLine(IMPORTER *im) {
+    int skipping = 0;
+    for(;;) {
+        char *start = im->buffer + im->start;
+        char *newline = memchr(start, '\n', im->end - im->start);
+        if(newline == NULL && im->eof && im->start < im->end)
+            newline = im->buffer + im->end;     //Last line, without a newline
+        if(newline != NULL) {
+            *newline = '\0';
+            im->start = newline - im->buffer + 1;
+            if(im->start > im->end)
+                im->start = im->end;
+            if(skipping) {          //End of a long line already counted
+                skipping = 0;
+                continue;
+            }
+            if(newline - start >= LINE_SIZE) {
+                im->stats.lines++;
+                im->stats.malformed++;
+                continue;
+            }
+            if(newline > start && newline[-1] == '\r')
+                newline[-1] = '\0';
+            im->line = start;
+            im->stats.lines++;
+            return 1;
+        }
+        if(im->eof)
+            return 0;
+
+        size_t left = im->end - im->start;
+        if(left >= LINE_SIZE) {     //Too long; drop it up to its newline
+            if(!skipping) {
+                im->stats.lines++;
+                im->stats.malformed++;
+            }
+            skipping = 1;
+            left = 0;
+        }
+        memmove(im->buffer, start, left);
+        int got = gzread(im->in, im->buffer + left, READ_BUFFER - left);
+        if(got <= 0)
+            im->eof = 1;
+        im->start = 0;
+        im->end = left + (got > 0 ? got : 0);
+    }
+}
+/*
+ * Lackey prints one access per line, as "I  addr,size" for an instruction
+ * fetch and " L addr,size", " S addr,size" or " M addr,size" for a load,
+ * store or modify(a load then a store) of data. Its own messages start with
+ * "==pid==", which gives the process.
+ * Returns 1 for a reference, 0 for a line without one, or -1 if malformed.
+ */
+static int parseLackey(IMPORTER *im, TRACE_REF *ref) {
+    char *p = im->line;
+    if(p[0] == '=' && p[1] == '=') {
+        long pid = strtol(p + 2, NULL, 10);
+        if(pid > 0)
+            im->lackeyProcess = lookupProcess(im, pid);
+        return 0;
+    }
+    while(*p == ' ')
+        p++;
+    char type = *p;
+    if(type == '\0')
+        return 0;
+    if(type != 'I' && type != 'L' && type != 'S' && type != 'M')
+        return -1;
+    if(type == 'I' && !(im->flags & IMPORT_INSTRUCTIONS))
+        return 0;
+    p++;
+    while(*p == ' ')
+        p++;
+    char *comma = strchr(p, ',');
+    if(comma == NULL)
+        return -1;
+    *comma = '\0';
+
+    if(im->lackeyProcess == LACKEY_UNKNOWN)     //Registered like any pid, so a real one cannot share its process
+        im->lackeyProcess = lookupProcess(im, LACKEY_NO_PID);
+    int asid = im->lackeyProcess;
+    if(asid < 0) {
+        im->stats.dropped += type == 'M' ? 2 : 1;
+        return 0;
+    }
+    memset(ref, 0, sizeof(TRACE_REF));
+    ref->asid = asid;
+    if(parseAddress(p, 1, &ref->vaddr) != 0)
+        return -1;
+    ref->kind = type == 'S' ? TRACE_WRITE : TRACE_READ;
+    ref->value = ref->kind == TRACE_WRITE ? IMPORT_WRITE_VALUE : 0;
+    if(type == 'M') {
+        im->pending = *ref;
+        im->pending.kind = TRACE_WRITE;
+        im->pending.value = IMPORT_WRITE_VALUE;
+        im->hasPending = 1;
+    }
+    return 1;
+}
+/*
+ * perf script prints a sample as "comm pid[/tid] [cpu] time: [period] event:
+ * addr ...", where the event of a perf mem record names loads or stores;
+ * samples of any other event are skipped. perf mem report -D prints
+ * "pid tid ip addr ..." instead, without telling loads from stores, so those
+ * are all reads.
+ * Returns 1 for a reference, 0 for a line without one, or -1 if malformed.
+ */
+static int parsePerf(IMPORTER *im, TRACE_REF *ref) {
+    char *fields[MAX_FIELDS];
+    int n = splitFields(im->line, ' ', fields);
+    if(n == 0 || fields[0][0] == '#')
+        return 0;
+    memset(ref, 0, sizeof(TRACE_REF));
+
+    if(n >= 4 && isdigit((unsigned char)fields[0][0]) && strncmp(fields[2], "0x", 2) == 0) {   //Raw dump
+        int asid = lookupProcess(im, strtol(fields[0], NULL, 10));
+        if(asid < 0) {
+            im->stats.dropped++;
+            return 0;
+        }
+        ref->asid = asid;
+        ref->kind = TRACE_READ;
+        return parseAddress(fields[3], 1, &ref->vaddr) == 0 ? 1 : -1;
+    }
+
+    long pid = -1;
+    int event = -1;
+    for(int i=1; i<n && event<0; i++) {
+        char *f = fields[i];
+        size_t len = strlen(f);
+        if(f[0] == '[' && f[len-1] == ']') {   //CPU, which follows the pid
+            if(im->flags & IMPORT_CPUS)
+                ref->cpu = (int)strtol(f + 1, NULL, 10);
+        } else if(pid < 0 && isdigit((unsigned char)f[0]) && f[len-1] != ':') {
+            char *end;
+            long value = strtol(f, &end, 10);
+            if(*end == '\0' || *end == '/')
+                pid = value;
+        } else if(f[len-1] == ':' && strpbrk(f, "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ") != NULL) {
+            event = i;
+        }
+    }
+    if(event < 0 || pid < 0)
+        return -1;
+    if(containsWord(fields[event], "store"))
+        ref->kind = TRACE_WRITE;
+    else if(containsWord(fields[event], "load") || containsWord(fields[event], "mem"))
+        ref->kind = TRACE_READ;
+    else
+        return 0;   //Some other event
+    for(int i=event+1; i<n; i++) {
+        if(parseAddress(fields[i], 1, &ref->vaddr) == 0) {
+            int asid = lookupProcess(im, pid);
+            if(asid < 0) {
+                im->stats.dropped++;
+                return 0;
+            }
+            ref->asid = asid;
+            ref->value = ref->kind == TRACE_WRITE ? IMPORT_WRITE_VALUE : 0;
+            return 1;
+        }
+    }
+    return -1;
+}
+/*
+ * A CSV trace has address, rw and pid columns, in that order unless a header
+ * line names them(address/addr, rw/op/type, pid/asid/process, in any case).
+ * The pid column may be left out. Addresses are decimal, or hex with 0x;
+ * rw is R/L/0 for a read and W/S/1 for a write.
+ * Returns 1 for a reference, 0 for a line without one, or -1 if malformed.
+ */
+static int parseCSV(IMPORTER *im, TRACE_REF *ref) {
+    char *fields[MAX_FIELDS];
+    int n = splitFields(im->line, ',', fields);
+    if((n == 1 && fields[0][0] == '\0') || fields[0][0] == '#')
+        return 0;
+    memset(ref, 0, sizeof(TRACE_REF));
+    if(!im->sawHeader) {
+        im->sawHeader = 1;
+        unsigned int vaddr;
+        if(n > im->addressColumn && parseAddress(fields[im->addressColumn], 0, &vaddr) != 0) {
+            im->pidColumn = -1;
+            for(int i=0; i<n; i++) {
+                if(strcasecmp(fields[i], "address") == 0 || strcasecmp(fields[i], "addr") == 0)
+                    im->addressColumn = i;
+                else if(strcasecmp(fields[i], "rw") == 0 || strcasecmp(fields[i], "op") == 0 || strcasecmp(fields[i], "type") == 0)
+                    im->rwColumn = i;
+                else if(strcasecmp(fields[i], "pid") == 0 || strcasecmp(fields[i], "asid") == 0 || strcasecmp(fields[i], "process") == 0)
+                    im->pidColumn = i;
+            }
+            return 0;
+        }
+    }
+    if(n <= im->addressColumn || n <= im->rwColumn)
+        return -1;
+    if(parseAddress(fields[im->addressColumn], 0, &ref->vaddr) != 0)
+        return -1;
+    switch(toupper((unsigned char)fields[im->rwColumn][0])) {
+    case 'R': case 'L': case '0':
+        ref->kind = TRACE_READ;
+        break;
+    case 'W': case 'S': case '1':
+        ref->kind = TRACE_WRITE;
+        ref->value = IMPORT_WRITE_VALUE;
+        break;
+    default:
+        return -1;
+    }
+    long pid = 0;
+    if(im->pidColumn >= 0 && im->pidColumn < n)
+        pid = strtol(fields[im->pidColumn], NULL, 10);
+    int asid = lookupProcess(im, pid);
+    if(asid < 0) {
+        im->stats.dropped++;
+        return 0;
+    }
+    ref->asid = asid;
+    return 1;
+}
+/*
+ * Splits a line in place into fields, trimming spaces from each. A space as
+ * the separator splits at every run of spaces or tabs.
+ * Returns the number of fields.
+ */
+static int splitFields(char *line, char separator, char **fields) {
+    int n = 0;
+    char *p = line;
+    if(separator == ' ') {
+        while(n < MAX_FIELDS) {
+            while(*p == ' ' || *p == '\t')
+                p++;
+            if(*p == '\0')
+                break;
+            fields[n++] = p;
+            while(*p != '\0' && *p != ' ' && *p != '\t')
+                p++;
+            if(*p != '\0')
+                *p++ = '\0';
+        }
+        return n;
+    }
+    while(n < MAX_FIELDS) {
+        while(*p == ' ' || *p == '\t')
+            p++;
+        char *start = p;
+        while(*p != '\0' && *p != separator)
+            p++;
+        int last = *p == '\0';
+        char *end = p;
+        while(end > start && (end[-1] == ' ' || end[-1] == '\t'))
+            end--;
+        *end = '\0';
+        fields[n++] = start;
+        if(last)
+            break;
+        p++;
+    }
+    return n;
+}
+/*
+ * Checks whether s contains word, ignoring case.
+ */
+static int containsWord(const char *s, const char *word) {
+    size_t len = strlen(word);
+    for(; *s != '\0'; s++) {
+        if(strncasecmp(s, word, len) == 0)
+            return 1;
+    }
+    return 0;
+}
+/*
+ * Parses a whole field as an address, keeping its low 32 bits. Addresses are
+ * hex(with or without 0x) if hex is set; otherwise they are decimal unless
+ * they start with 0x or hold hex digits.
+ * Returns 0 on success, or -1 if the field is not an address or does not fit
+ * in 64 bits.
+ */
+static int parseAddress(const char *s, int hex, unsigned int *vaddr) {
+    const char *p = s;
+    if(p[0] == '0' && (p[1] == 'x' || p[1] == 'X')) {
+        hex = 1;
+        p += 2;
+    }
+    unsigned long long decimal = 0, address = 0;
+    int digits = 0, hexOverflow = 0, decimalOverflow = 0;
+    for(; *p != '\0'; p++, digits++) {
+        int d;
+        if(*p >= '0' && *p <= '9')
+            d = *p - '0';
+        else if(*p >= 'a' && *p <= 'f')
+            d = *p - 'a' + 10;
+        else if(*p >= 'A' && *p <= 'F')
+            d = *p - 'A' + 10;
+        else
+            return -1;
+        if(d >= 10)
+            hex = 1;
+        if(address > ULLONG_MAX >> 4)
+            hexOverflow = 1;
+        if(decimal > (ULLONG_MAX - (unsigned long long)d) / 10)
+            decimalOverflow = 1;
+        address = address << 4 | (unsigned long long)d;
+        decimal = decimal * 10 + (unsigned long long)d;
+    }
+    if(digits == 0 || (hex ? hexOverflow : decimalOverflow))
+        return -1;
+    *vaddr = (unsigned int)(hex ? address : decimal);
+    return 0;
+}
+/*
+ * Returns the process number of the given pid, giving it the next one if it
+ * is new, or -1 if there are already as many processes as allowed.
+ */
+static int lookupProcess(IMPORTER *im, long pid) {
+    unsigned int mask = (unsigned int)im->tableSize - 1;
+    unsigned int slot = (unsigned int)((unsigned long)pid * 2654435761u) & mask;
+    while(im->asids[slot] != -1) {
+        if(im->pids[slot] == pid)
+            return im->asids[slot];
+        slot = (slot + 1) & mask;
+    }
+    if(im->numProcesses >= im->maxProcesses)
+        return -1;  //The table is never more than half full, so there is always a free slot
+    im->pids[slot] = pid;
+    im->asids[slot] = im->numProcesses;
+    return im->numProcesses++;
+}
@@ -0,0 +1,44 @@
+#ifndef IMPORT_H
+#define IMPORT_H
+
+#include "trace.h"
+
+/*
+ * Streaming readers of memory traces recorded by other tools. Each turns its
+ * format into the simulator's references(process, address, read or write)
+ * one line at a time, so memory use does not grow with the trace. The input
+ * may be gzip'd; "-" reads from stdin.
+ *   IMPORT_LACKEY  valgrind --tool=lackey --trace-mem=yes
+ *   IMPORT_PERF    perf script of perf mem record, or perf mem report -D
+ *   IMPORT_CSV     address,rw,pid columns(in that order, or named by a header)
+ * Processes are numbered in the order they first appear. Addresses keep
+ * their low 32 bits, which the simulator wraps around the size of the
+ * "program" like any other. None of the formats records the data written, so
+ * every write stores IMPORT_WRITE_VALUE; the values the simulator later reads
+ * back from written pages are synthetic.
+ */
+#define IMPORT_LACKEY 0
+#define IMPORT_PERF 1
+#define IMPORT_CSV 2
+
+#define IMPORT_INSTRUCTIONS 1   //Lackey: instruction fetches are reads too
+#define IMPORT_CPUS 2           //perf: keep the CPU each sample was taken on
+
+#define IMPORT_WRITE_VALUE 1    //Byte stored by every imported write
+
+typedef struct importer IMPORTER;
+
+typedef struct import_stats {
+    long lines;
+    long references;
+    long malformed;         //Lines that could not be parsed
+    long dropped;           //References of processes past the limit
+} IMPORT_STATS;
+
+extern int formatImport(const char *name);
+extern IMPORTER *newImporter(const char *path, int format, int maxProcesses, int flags);
+extern int nextImported(IMPORTER *im, TRACE_REF *ref);
+extern void statsImport(const IMPORTER *im, IMPORT_STATS *stats);
+extern void freeImporter(IMPORTER *im);
+
+#endif
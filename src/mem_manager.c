@@ -1,144 +1,57 @@
+#define _POSIX_C_SOURCE 200809L  //For getopt
 #include <stdio.h>
 #include <stdlib.h>
-#include <assert.h>
-#include "scanner.h"    //For reading the input file
-#include "dll.h"        //For the LRU page replacement
-
-#define PROGRAM_MEMORY_SIZE 65536               //Size of the "program" in bytes
-#define ALLOCATED_MEMORY 65536/2                //Size of the memory allocated to the "program" in bytes
-#define PAGE_SIZE 256                           //Size of each page in bytes
-#define TLB_SIZE 16                             //Number of entries in the TLB
-#define NUM_BUFFER 100
-#define ADDR_BUFFER 100
-
-/*
- * Can hold the information of a logical or physical address.
- * Location holds the page/frame number, offset holds the offset.
- */
-typedef struct address {
-    unsigned int location, offset;
-} ADDRESS;
-static ADDRESS *newADDRESS(unsigned int pf, unsigned int o) {
-    ADDRESS *a = malloc(sizeof(ADDRESS));
-    assert(a != 0);
-
-    a->location = pf;
-    a->offset = o;
-    return a;
-}
-
-/*
- * Contains a char array to simulate holding an array of bytes.
- * Also holds an integer for its identifying number.
- */
-typedef struct page {
-    int number;
-    char *content;
-} PAGE;
-static PAGE *newPAGE(int n, char *c) {
-    PAGE *p = malloc(sizeof(PAGE));
-    assert(p != 0);
-
-    p->number = n;
-    p->content = c;
-    //printf("Created page %d\n", n);
-    return p;
-}
-static void freePAGE(PAGE *p) {
-    free(p->content);
-    //printf("Freeing page %d...\n", p->number);
-    free(p);
-}
-static void displayPage(void *v, FILE *fp) {
-    PAGE *p = v;
-    if(p)
-        fprintf(fp, "PageNum: %d", p->number);
-    else
-        fprintf(fp, "NULL PAGE");
-}
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>    //One thread per simulated CPU
+#include "trace.h"      //For reading the input file
+#include "vmm.h"        //The simulator itself
+#include "mrc.h"        //For approximate miss ratio curves
+#include "telemetry.h"  //For interval reports while the replay runs
 
 /*
- * Contains the page number and frame number of a single entry in the TLB
- * table.
+ * Where the replay starts, where(if anywhere) to write a checkpoint, and
+ * where(if anywhere) to report intervals.
  */
-typedef struct tlb_entry {
-    int pageNum, frameNum;
-} TLB_ENTRY;
-TLB_ENTRY *newTLB_ENTRY(int p, int f) {
-    TLB_ENTRY *t = malloc(sizeof(TLB_ENTRY));
-    assert(t != 0);
-
-    t->pageNum = p;
-    t->frameNum = f;
-    return t;
-}
+typedef struct replay {
+    long start;
+    long checkpointAt;
+    const char *checkpointPath;
+    TELEMETRY *telemetry;
+} REPLAY;
 
 /*
- * Holds the mappings from pages to frames.
- * page_to_frame has indexes that relate to the page numbers. The integer stored
- * at that index relates to its frame number. If the number is -1, then that
- * page is not currently in memory.
+ * Shared by the threads that stand in for the simulated CPUs. They take turns
+ * in the order of the input file: the thread whose CPU makes reference turn
+ * runs while the others wait on their own condition variable.
  */
-typedef struct page_table {
-    int *page_to_frame;
-    int numPages, numFrames, freeFrames;
-} PAGE_TABLE;
-static PAGE_TABLE *newPAGE_TABLE(int numP, int numF) {
-    PAGE_TABLE *p = malloc(sizeof(PAGE_TABLE));
-    assert(p != 0);
-
-    p->page_to_frame = malloc(sizeof(int) * numP);
-    assert(p->page_to_frame != 0);
-    for(int i=0; i<numP; i++) {
-        p->page_to_frame[i] = -1;   //Initialize each value to the unmapped value -1
-    }
-
-    p->numPages = numP;
-    p->numFrames = numF;
-    p->freeFrames = numF;
-    return p;
-}
-static int getFrameNumber(PAGE_TABLE *table, int pageNum) {
-    return table->page_to_frame[pageNum];
-}
-static void addPageTableEntry(PAGE_TABLE *table, int pageNum, int frameNum) {
-    table->page_to_frame[pageNum] = frameNum;
-    table->freeFrames--;
-}
-static void removePageTableEntry(PAGE_TABLE *table, int pageNum) {
-    if(table->page_to_frame[pageNum] == -1)
-        fprintf(stderr, "Error, attempting to remove an entry with page number %d.\n", pageNum);
-    table->page_to_frame[pageNum] = -1;
-    table->freeFrames++;
-}
-
-static void initializeTables();
-static void initializeStats();
-static int *readNumbers(FILE *fp);
-static ADDRESS **parseAddresses(int *nums);
-static void reportValues(ADDRESS **logicalAddr);
-static ADDRESS *translateAddress(ADDRESS *addr);
-static unsigned int getByte(ADDRESS *addr);
-static void reportStats();
-
-static ADDRESS *lookupTLB(ADDRESS *addr);
-static ADDRESS *lookupPageTable(ADDRESS *addr);
-static ADDRESS *loadPage(ADDRESS *addr);
-
-static void pushPageLRU(PAGE *p);
-static void updatePageLRU(PAGE *p);
-static PAGE *popPageLRU();
-
-static void addTLBEntry(TLB_ENTRY *e);
-static int findTLBEntry(int pageNum);
+typedef struct cpus {
+    VMM_CTX *ctx;
+    TRACE *trace;
+    const REPLAY *replay;
+    long turn;
+    pthread_mutex_t lock;
+    pthread_cond_t *ready;  //One per CPU
+} CPUS;
+typedef struct cpu_thread {
+    CPUS *cpus;
+    int cpu;
+} CPU_THREAD;
 
-PAGE *frames[ALLOCATED_MEMORY/PAGE_SIZE];   //Stores the pages in "memory"(frames)
-TLB_ENTRY *tlb[TLB_SIZE];                   //Stores the tlb entries in a small table(array)
-int sizeTLB, oldestTLB;
-PAGE_TABLE *pageTable;                      //Stores the mappings of all pages in "memory"(frames)
-DLL *pageStack;                             //Stores all pages in order of usage(0 - recent, maxSize - least)
-int numPageAccesses, numPageFaults, numTLBLookups, numTLBHits;  //Various statistics
-char *PROGRAM_LOCATION;
+static void reportValues(VMM_CTX *ctx, TRACE *trace, const REPLAY *replay);
+static void reportValuesOnCPUs(VMM_CTX *ctx, TRACE *trace, const REPLAY *replay);
+static void *runCPU(void *arg);
+static void replayReference(VMM_CTX *ctx, TRACE *trace, const REPLAY *replay, long i);
+static void reportRuns(VMM_CTX *ctx, TRACE_RUNS *runs, int print, TELEMETRY *telemetry);
+static int parseInterval(const char *spec, long *every, double *seconds);
+static void reportReduction(VMM_CTX *ctx, TRACE *trace);
+static double now(void);
+static int parseNodes(VMM_CONFIG *config, char *spec);
+static int parsePolicy(VMM_CONFIG *config, const char *spec);
+static int parseScheduler(VMM_CONFIG *config, const char *spec);
+static void reportCurve(FILE *fp, const VMM_CONFIG *config, double rate, long maxSamples);
+static void reportStats(VMM_CTX *ctx);
 
 /*
  * Created by Zach Wassynger on 14 April 2018.
@@ -148,283 +61,638 @@ char *PROGRAM_LOCATION;
  * returns the contents at the physical addresses(in a bin).
  */
 int main(int argc, char **argv) {
-    if(argc != 3) {
-        fprintf(stderr, "Incorrect usage of parameters. Correct usage: %s <program_location> <inputfile>\n", argv[0]);
+    VMM_CONFIG config;
+    vmm_default_config(&config);
+    REPLAY replay = {0, -1, NULL, NULL};
+    const char *resumePath = NULL;
+    char *colon;
+    double sampleRate = 0;  //Miss ratio curve mode when not 0
+    long maxSamples = 0;
+    const char *profilePath = NULL;
+    const char *eventPath = NULL;
+    const char *telemetryPath = NULL;
+    long every = 0;         //References per telemetry interval
+    double seconds = 1;     //Seconds per telemetry interval
+    int window = 10;        //Intervals in the telemetry's sliding window
+    int runs = 0;   //1 replays the trace reduced to page runs, 2 also compares that to a full replay
+
+    int opt;
+    while((opt = getopt(argc, argv, "z:k:Zs:r:m:S:i:pPH:n:L:N:a:T:t:e:j:J:W:D:O:V:")) != -1) {
+        switch(opt) {
+        case 'z':   //Size of the compressed swap pool in bytes
+            config.zswapSize = strtoul(optarg, NULL, 0);
+            break;
+        case 'k':   //References between deduplication passes
+            config.dedupInterval = strtol(optarg, NULL, 0);
+            break;
+        case 'Z':   //Map pages of all zeros to the shared zero page
+            config.zeroPages = 1;
+            break;
+        case 's':   //Checkpoint before the given reference, as <index>:<file>
+            replay.checkpointAt = strtol(optarg, &colon, 10);
+            if(*colon != ':' || replay.checkpointAt < 0)
+                argc = -1;
+            replay.checkpointPath = colon + 1;
+            break;
+        case 'r':   //Resume from a checkpoint
+            resumePath = optarg;
+            break;
+        case 'm':   //Print a miss ratio curve, sampling this fraction of pages
+            sampleRate = strtod(optarg, NULL);
+            if(sampleRate <= 0 || sampleRate > 1)
+                argc = -1;
+            break;
+        case 'S':   //Cap the curve's sample set at this many pages
+            maxSamples = strtol(optarg, NULL, 0);
+            if(sampleRate == 0)
+                sampleRate = 1;
+            break;
+        case 'i':   //Cost of a TLB shootdown IPI in cycles
+            config.ipiCycles = strtol(optarg, NULL, 0);
+            break;
+        case 'H':   //Write the page heat map and reuse histogram(binary if the name ends in .bin)
+            profilePath = optarg;
+            break;
+        case 'p':   //Replay the trace reduced to runs of references to one page
+            runs = 1;
+            break;
+        case 'P':   //Same, but only report the reduction and its speedup
+            runs = 2;
+            break;
+        case 'n':   //NUMA nodes, as size[:latency_ns],...
+            if(parseNodes(&config, optarg) != 0)
+                argc = -1;
+            break;
+        case 'L':   //Extra nanoseconds of an access to another node
+            config.remoteLatency = strtol(optarg, NULL, 0);
+            break;
+        case 'N':   //Placement of new pages: first-touch, interleave or preferred[:node]
+            if(parsePolicy(&config, optarg) != 0)
+                argc = -1;
+            break;
+        case 'a':   //References between AutoNUMA samples
+            config.numaScanInterval = strtol(optarg, NULL, 0);
+            break;
+        case 'T':   //Slow memory tier, as size[:latency_ns]
+            config.slowSize = strtoul(optarg, &colon, 0);
+            if(*colon == ':')
+                config.slowLatency = strtol(colon + 1, &colon, 0);
+            if(*colon != '\0')
+                argc = -1;
+            break;
+        case 't':   //Promotion sampling, as interval[:threshold]
+            config.promoteInterval = strtol(optarg, &colon, 0);
+            if(*colon == ':')
+                config.promoteThreshold = (int)strtol(colon + 1, &colon, 0);
+            if(*colon != '\0')
+                argc = -1;
+            break;
+        case 'e':   //Log faults, evictions, TLB fills and the like to a binary file
+            eventPath = optarg;
+            break;
+        case 'j':   //Report intervals as JSON lines to a file or FIFO
+            telemetryPath = optarg;
+            break;
+        case 'J':   //Length of an interval, as references, seconds(e.g. 2.5s) or both
+            if(parseInterval(optarg, &every, &seconds) != 0)
+                argc = -1;
+            break;
+        case 'W':   //Intervals in the sliding window
+            window = atoi(optarg);
+            if(window <= 0)
+                argc = -1;
+            break;
+        case 'D':   //Swap devices, as count[:stripe_pages[:queue_depth]]
+            config.swapDevices = (int)strtol(optarg, &colon, 0);
+            if(*colon == ':')
+                config.swapStripe = (int)strtol(colon + 1, &colon, 0);
+            if(*colon == ':')
+                config.swapDepth = (int)strtol(colon + 1, &colon, 0);
+            if(*colon != '\0' || config.swapDevices <= 0)
+                argc = -1;
+            break;
+        case 'O':   //Order of swap requests: fifo, elevator or deadline[:ns]
+            if(parseScheduler(&config, optarg) != 0)
+                argc = -1;
+            break;
+        case 'V':   //Swap device timing, as latency_ns[:full_seek_ns]
+            config.swapLatency = strtol(optarg, &colon, 0);
+            if(*colon == ':')
+                config.swapSeek = strtol(colon + 1, &colon, 0);
+            if(*colon != '\0')
+                argc = -1;
+            break;
+        default:
+            argc = -1;  //Forces the usage message below
+        }
+    }
+    if(runs && (resumePath != NULL || replay.checkpointPath != NULL)) {
+        fprintf(stderr, "Page runs cannot be combined with checkpoints.\n");
+        argc = -1;
+    }
+    if(argc - optind != 2) {
+        fprintf(stderr, "Incorrect usage of parameters. Correct usage: %s [-z zswap_bytes] [-k dedup_interval] [-Z] [-s index:checkpoint] [-r checkpoint] [-m sample_rate] [-S max_samples] [-i ipi_cycles] [-p | -P] [-H profile] [-n size[:latency],...] [-L remote_ns] [-N first-touch|interleave|preferred[:node]] [-a scan_interval] [-T slow_bytes[:latency]] [-t interval[:threshold]] [-e event_log] [-j telemetry [-J refs|secs[s],...] [-W window]] [-D devices[:stripe[:depth]]] [-O fifo|elevator|deadline[:ns]] [-V latency[:seek]] <program_location> <inputfile|->\n", argv[0]);
         return -1;
     }
-    
-    PROGRAM_LOCATION = argv[1];
+    config.backingStore = argv[optind];
 
-    FILE *fp = fopen(argv[2], "r");
+    FILE *fp = strcmp(argv[optind+1], "-") == 0 ? stdin : fopen(argv[optind+1], "r");
     if(fp == NULL) {
         fprintf(stderr, "File could not be read from.\n");
         return -2;
     }
+    if(sampleRate != 0) {
+        reportCurve(fp, &config, sampleRate, maxSamples);
+        return 0;
+    }
+    TRACE *trace = readTrace(fp);
+    config.numProcesses = trace->numProcesses;
+    config.numCPUs = trace->numCPUs;
 
-    initializeTables();
-    initializeStats();
-    int *nums = readNumbers(fp);
-    ADDRESS **logicalAddr = parseAddresses(nums);
-    reportValues(logicalAddr);
-
-    reportStats();
+    VMM_CTX *ctx;
+    if(resumePath != NULL) {    //The configuration comes from the checkpoint
+        ctx = vmm_restore(resumePath, config.backingStore, &replay.start);
+        if(ctx != NULL) {
+            vmm_get_config(ctx, &config);
+            if(config.numProcesses < trace->numProcesses) {
+                fprintf(stderr, "The checkpoint has fewer processes than the input file uses.\n");
+                vmm_destroy(ctx);
+                ctx = NULL;
+            } else if(config.numCPUs < trace->numCPUs) {
+                fprintf(stderr, "The checkpoint has fewer CPUs than the input file uses.\n");
+                vmm_destroy(ctx);
+                ctx = NULL;
+            }
+        }
+    } else {
+        ctx = vmm_create(&config);
+    }
+    if(ctx == NULL || (eventPath != NULL && vmm_open_event_log(ctx, eventPath) != 0)) {
+        freeTrace(trace);
+        vmm_destroy(ctx);
+        return -2;
+    }
+    if(telemetryPath != NULL && runs != 2) {
+        replay.telemetry = newTelemetry(ctx, telemetryPath, every, seconds, window);
+        if(replay.telemetry == NULL) {
+            freeTrace(trace);
+            vmm_destroy(ctx);
+            return -2;
+        }
+    }
+    if(runs == 2) {
+        reportReduction(ctx, trace);
+    } else if(runs == 1) {
+        TRACE_RUNS *reduced = reduceTrace(trace, config.virtualSize, config.pageSize);
+        reportRuns(ctx, reduced, 1, replay.telemetry);
+        freeTraceRuns(reduced);
+        reportStats(ctx);
+    } else {
+        if(config.numCPUs > 1)
+            reportValuesOnCPUs(ctx, trace, &replay);
+        else
+            reportValues(ctx, trace, &replay);
+        reportStats(ctx);
+    }
+    if(replay.telemetry != NULL)
+        freeTelemetry(replay.telemetry, ctx);
+    if(profilePath != NULL) {
+        size_t len = strlen(profilePath);
+        int binary = len >= 4 && strcmp(profilePath + len - 4, ".bin") == 0;
+        vmm_write_profile(ctx, profilePath, binary ? VMM_PROFILE_BINARY : VMM_PROFILE_CSV);
+    }
+    if(eventPath != NULL) {
+        long events = vmm_close_event_log(ctx);
+        if(events >= 0)
+            fprintf(stderr, "Event log written to %s (%ld events).\n", eventPath, events);
+    }
+    freeTrace(trace);
+    vmm_destroy(ctx);
     return 0;
 }
 
 /*
- * Initializes all the static variables pertaining to the tables and various
- * means of looking pages up.
- */
-static void initializeTables() {
-    pageTable = newPAGE_TABLE(PROGRAM_MEMORY_SIZE/PAGE_SIZE, ALLOCATED_MEMORY/PAGE_SIZE);
-    pageStack = newDLL(&displayPage, NULL); //Stores pages
-    sizeTLB = 0;
-    oldestTLB = 0;
-}
-/*
- * Initializes all the static variables pertaining to statistic
- * tracking.
+ * Finds(or stores) the value of each byte for each logical address provided,
+ * starting at the replay's start index.
+ * Addresses wrap around the size of the "program"; with the default geometry
+ * the left 8 bits are the page number and the right 8 bits are the offset.
  */
-static void initializeStats() {
-    numPageAccesses = 0;
-    numPageFaults = 0;
-    numTLBLookups = 0;
-    numTLBHits = 0;
+static void reportValues(VMM_CTX *ctx, TRACE *trace, const REPLAY *replay) {
+    for(long i=replay->start; i<=trace->count; i++)
+        replayReference(ctx, trace, replay, i);
 }
 /*
- * Reads from a file into a dynamically allocated array of ints.
- * Assumes the ints are delimited by whitespace(and maybe a comma).
- * Closes the file(fp) after EOF reached.
- * Returns the array of ints with a -1 denoting the end of the list.
+ * Same as reportValues, but every simulated CPU makes its references on a
+ * thread of its own. The threads hand the simulator over to each other after
+ * every reference, in the order of the input file, so the output does not
+ * depend on how they are scheduled.
  */
-static int *readNumbers(FILE *fp) {
-    int *nums = malloc(sizeof(int) * NUM_BUFFER);
-    int size = 0, capacity = NUM_BUFFER;
-
-    char *token = readToken(fp);
-    while(token != NULL) {
-        if(size >= capacity) {
-            capacity += NUM_BUFFER;
-            nums = realloc(nums, sizeof(int) * capacity);
-        }
-        nums[size++] = atoi(token);
-        token = readToken(fp);
+static void reportValuesOnCPUs(VMM_CTX *ctx, TRACE *trace, const REPLAY *replay) {
+    VMM_CONFIG config;
+    vmm_get_config(ctx, &config);
+    CPUS cpus = {ctx, trace, replay, replay->start, PTHREAD_MUTEX_INITIALIZER, NULL};
+    cpus.ready = malloc(sizeof(pthread_cond_t) * config.numCPUs);
+    pthread_t *threads = malloc(sizeof(pthread_t) * config.numCPUs);
+    CPU_THREAD *args = malloc(sizeof(CPU_THREAD) * config.numCPUs);
+    if(cpus.ready == NULL || threads == NULL || args == NULL) {
+        fprintf(stderr, "Could not allocate %d CPUs.\n", config.numCPUs);
+        exit(-5);
     }
-    nums = realloc(nums, sizeof(int) * (size+1));
-    nums[size] = -1;    //End the array with a -1, signifying the end
-    fclose(fp);
-    return nums;
-}
-/*
- * Parses out logical/physical addresses from an integer array.
- * Assumes that for the 16-bit integer, the 8 bits on the left are
- * the page/frame number, and the 8 bits on the right are the
- * offset. Also assumes the list of ints is terminated with a -1.
- * Returns a NULL terminated array of ADDRESS pointers.
- */
-static ADDRESS **parseAddresses(int *nums) {
-    ADDRESS **addr = malloc(sizeof(ADDRESS *) * ADDR_BUFFER);
-    int size = 0, capacity = ADDR_BUFFER;
-
-    unsigned int location, offset;
-    int index = 0, temp = nums[index++];
-    while(temp != -1) {
-        offset = (unsigned int)(temp & 0x00FF);              //Mask the right 8 bits
-        location = (unsigned int)((temp >> 8) & 0x00FF);     //Bit shift the int so that the left 8 bits can be accessed
-        if(size >= capacity) {
-            capacity += ADDR_BUFFER;
-            addr = realloc(addr, sizeof(ADDRESS *) * capacity);
+    for(int c=0; c<config.numCPUs; c++)
+        pthread_cond_init(&cpus.ready[c], NULL);
+    for(int c=0; c<config.numCPUs; c++) {
+        args[c].cpus = &cpus;
+        args[c].cpu = c;
+        if(pthread_create(&threads[c], NULL, &runCPU, &args[c]) != 0) {
+            fprintf(stderr, "Could not start the thread of CPU %d.\n", c);
+            exit(-5);
         }
-        addr[size++] = newADDRESS(location, offset);
-        temp = nums[index++];
     }
-    addr = realloc(addr, sizeof(ADDRESS *) * (size+1));
-    addr[size] = NULL;  //Null terminate the end of the list.
-    return addr;
-}
-/*
- * Finds the value of each byte for each logical address provided.
- */
-static void reportValues(ADDRESS **logicalAddr) {
-    int index = 0;
-    ADDRESS *physicalAddr;
-    ADDRESS *temp = logicalAddr[index++];
-    while(temp != NULL) {
-        physicalAddr = translateAddress(temp);
-        signed char byte = getByte(physicalAddr);
-        /*
-        char *byteRep = malloc(sizeof(char) * 9);   //Size of byte + 1(for null terminator)
-        for(int i=0; i<8; i++) {
-            byteRep[i] = byte & 1 ? '1' : '0';
-            byte >>= 1;
-        }
-        byteRep[8] = '\0';
-        */
-        int combinedLogical = (temp->location << 8) | temp->offset;
-        int combinedPhysical = (physicalAddr->location << 8) | physicalAddr->offset;
-        printf("Virtual address: %d Physical address: %d Value: %d\n", combinedLogical, combinedPhysical, byte);
+    for(int c=0; c<config.numCPUs; c++)
+        pthread_join(threads[c], NULL);
+    replayReference(ctx, trace, replay, trace->count);   //A checkpoint at the end
 
-        //free(byteRep);
-        temp = logicalAddr[index++];
-    }
+    for(int c=0; c<config.numCPUs; c++)
+        pthread_cond_destroy(&cpus.ready[c]);
+    pthread_mutex_destroy(&cpus.lock);
+    free(cpus.ready);
+    free(threads);
+    free(args);
 }
 /*
- * Translates a given logical address into a physical address.
- * First checks the TLB for a frame, and if not found, then checks the
- * page table. If there is a page fault, then a page is loaded into memory.
- * Then the frame is coupled with the given offset and returned as an
- * address.
+ * The thread of one simulated CPU. Waits for the turn of each of its
+ * references, makes it, then passes the turn to the CPU of the next one.
  */
-static ADDRESS *translateAddress(ADDRESS *addr) {
-    numPageAccesses++;          //Increments a stat
-    ADDRESS *physicalAddr = lookupTLB(addr);
-    if(physicalAddr != NULL)
-        return physicalAddr;    //If TLB lookup was successful
-    
-    physicalAddr = lookupPageTable(addr);
-    if(physicalAddr != NULL)
-        return physicalAddr;    //If page table lookup was successful
-    
-    numPageFaults++;            //Page fault, increment stat
-    return loadPage(addr);      //If page fault occurred
-}
-/*
- * Performs a lookup on the TLB for the given page number.
- * If a frame is found, then the address for the frame is returned.
- * If not, NULL is returned.
- */
-static ADDRESS *lookupTLB(ADDRESS *addr) {
-    numTLBLookups++;    //Increments a stat
-    int index = findTLBEntry(addr->location);
-    if(index != -1) {
-        numTLBHits++;   //Increments a stat
-        return newADDRESS(index, addr->offset);
+static void *runCPU(void *arg) {
+    CPU_THREAD *self = arg;
+    CPUS *cpus = self->cpus;
+    TRACE *trace = cpus->trace;
+    for(long i=cpus->replay->start; i<trace->count; i++) {
+        if(trace->refs[i].cpu != self->cpu)
+            continue;
+        pthread_mutex_lock(&cpus->lock);
+        while(cpus->turn != i)
+            pthread_cond_wait(&cpus->ready[self->cpu], &cpus->lock);
+        pthread_mutex_unlock(&cpus->lock);
+
+        replayReference(cpus->ctx, trace, cpus->replay, i);
+
+        pthread_mutex_lock(&cpus->lock);
+        cpus->turn = i + 1;
+        if(i + 1 < trace->count)
+            pthread_cond_signal(&cpus->ready[trace->refs[i+1].cpu]);
+        pthread_mutex_unlock(&cpus->lock);
     }
     return NULL;
 }
 /*
- * Performs a lookup on the page table for the given page number.
- * If a frame is found, then an address with the given frame and offset
- * is returned. If not, NULL is returned.
+ * Makes reference i of the input file(writing the checkpoint first if it is
+ * due there). Index trace->count only writes a checkpoint at the end.
  */
-static ADDRESS *lookupPageTable(ADDRESS *addr) {
-    int frameNumber = getFrameNumber(pageTable, addr->location);
-    if(frameNumber == -1)
-        return NULL;
-    addTLBEntry(newTLB_ENTRY(addr->location, frameNumber));
-    return newADDRESS(frameNumber, addr->offset);
+static void replayReference(VMM_CTX *ctx, TRACE *trace, const REPLAY *replay, long i) {
+    VMM_CONFIG config;
+    vmm_get_config(ctx, &config);
+    if(i == replay->checkpointAt && vmm_checkpoint(ctx, replay->checkpointPath, i) == 0)
+        fprintf(stderr, "Checkpoint written to %s before reference %ld.\n", replay->checkpointPath, i);
+    if(i == trace->count)
+        return;
+    TRACE_REF *ref = &trace->refs[i];
+    if(ref->kind == TRACE_FORK) {
+        if(vmm_fork_cpu(ctx, ref->cpu, ref->asid, ref->child) == 0)
+            printf("Process %d forked into process %d\n", ref->asid, ref->child);
+        return;
+    }
+    unsigned int logical = ref->vaddr % config.virtualSize, physical;
+    signed char byte = ref->value;
+    if(vmm_access_cpu(ctx, ref->cpu, ref->asid, logical, ref->kind == TRACE_WRITE, &byte, &physical) != 0)
+        return;
+    if(replay->telemetry != NULL)
+        tickTelemetry(replay->telemetry, ctx, 1);
+    if(config.numCPUs > 1)
+        printf("CPU: %d ", ref->cpu);
+    if(config.numProcesses > 1)
+        printf("Process: %d ", ref->asid);
+    printf("Virtual address: %u Physical address: %u Value: %d\n", logical, physical, byte);
 }
 /*
- * In the event of a page fault, the needed page must be loaded into memory.
- * To do so, there must be space in the frame table. If there is not, a page must 
- * be swapped out in favor of the new one. Once there is room, the frame is read from
- * file and loaded into the page table and TLB.
+ * Replays a trace reduced to page runs, taking the fast path over each run of
+ * reads(vmm_read_run). If print is set, the output of every reference is
+ * rebuilt from the run's offsets, and matches that of reportValues.
  */
-static ADDRESS *loadPage(ADDRESS *addr) {
-    int index = 0;
-    if(pageTable->freeFrames <= 0) {    //No space
-        PAGE *lru = popPageLRU();
-        if(lru == NULL) {
-            fprintf(stderr, "Could not remove the LRU page, exiting...\n");
-            exit(-4);
+static void reportRuns(VMM_CTX *ctx, TRACE_RUNS *runs, int print, TELEMETRY *telemetry) {
+    VMM_CONFIG config;
+    vmm_get_config(ctx, &config);
+    long capacity = 0;
+    unsigned int *paddrs = NULL;
+    signed char *values = NULL;
+    for(long r=0; r<runs->count; r++) {
+        TRACE_RUN *run = &runs->runs[r];
+        const unsigned int *offsets = &runs->offsets[run->first];
+        if(run->kind == TRACE_FORK) {
+            if(vmm_fork_cpu(ctx, run->cpu, run->asid, run->child) == 0 && print)
+                printf("Process %d forked into process %d\n", run->asid, run->child);
+            continue;
         }
-        int frame = getFrameNumber(pageTable, lru->number);
-        frames[frame] = NULL;
-        removePageTableEntry(pageTable, lru->number);
-        freePAGE(lru);
-        index = frame;  //Change starting index for quicker access later in the method
-    }
-    for(; index<ALLOCATED_MEMORY/PAGE_SIZE; index++) {
-        if(frames[index] == NULL) {
-            FILE *store = fopen(PROGRAM_LOCATION, "r");
-            int offset = addr->location * PAGE_SIZE;
-            fseek(store, offset, SEEK_SET);
-            char *data = malloc(sizeof(char) * PAGE_SIZE);
-            for(int i=0; i<PAGE_SIZE; i++)
-                data[i] = fgetc(store);
-            
-            PAGE *page = newPAGE(addr->location, data);
-            pushPageLRU(page);
-            frames[index] = page;
-            addPageTableEntry(pageTable, addr->location, index);
-            addTLBEntry(newTLB_ENTRY(addr->location, index));
-            fclose(store);
-            return newADDRESS(index, addr->offset);
+        if(print && run->count > capacity) {
+            capacity = run->count;
+            paddrs = realloc(paddrs, sizeof(unsigned int) * capacity);
+            values = realloc(values, capacity);
+            if(paddrs == NULL || values == NULL) {
+                fprintf(stderr, "Could not allocate a run of %ld references.\n", run->count);
+                exit(-5);
+            }
+        }
+        unsigned int base = run->page * config.pageSize;
+        if(run->kind == TRACE_WRITE) {
+            signed char byte = run->value;
+            unsigned int physical;
+            if(vmm_access_cpu(ctx, run->cpu, run->asid, base + offsets[0], 1, &byte, &physical) != 0)
+                continue;
+            if(print) {
+                paddrs[0] = physical;
+                values[0] = byte;
+            }
+        } else if(vmm_read_run(ctx, run->cpu, run->asid, run->page, offsets, run->count,
+                print ? paddrs : NULL, print ? values : NULL) != 0) {
+            continue;
+        }
+        if(telemetry != NULL)
+            tickTelemetry(telemetry, ctx, run->kind == TRACE_WRITE ? 1 : run->count);
+        for(long i=0; print && i<run->count; i++) {
+            if(config.numCPUs > 1)
+                printf("CPU: %d ", run->cpu);
+            if(config.numProcesses > 1)
+                printf("Process: %d ", run->asid);
+            printf("Virtual address: %u Physical address: %u Value: %d\n", base + offsets[i], paddrs[i], values[i]);
         }
     }
-    fprintf(stderr, "Error loading page - No space was found for new page.\n");
-    exit(-3);   //Fatal eror - should never reach here
+    free(paddrs);
+    free(values);
 }
 /*
- * Finds the requested byte at the given frame and offset.
+ * Reduces the trace to page runs and replays it on the given instance, then
+ * replays the full trace on a fresh one(neither prints anything), and
+ * reports the compaction ratio, the speedup, and whether the two agree.
  */
-static unsigned int getByte(ADDRESS *addr) {
-    PAGE *page = frames[addr->location];
-    if(page != NULL) {
-        updatePageLRU(page);
-        return page->content[addr->offset];
+static void reportReduction(VMM_CTX *ctx, TRACE *trace) {
+    VMM_CONFIG config;
+    vmm_get_config(ctx, &config);
+    double start = now();
+    TRACE_RUNS *runs = reduceTrace(trace, config.virtualSize, config.pageSize);
+    double reduced = now();
+    reportRuns(ctx, runs, 0, NULL);
+    double replayed = now();
+
+    VMM_CTX *full = vmm_create(&config);
+    if(full == NULL)
+        exit(-2);
+    double fullStart = now();
+    for(long i=0; i<trace->count; i++) {
+        TRACE_REF *ref = &trace->refs[i];
+        signed char byte = ref->value;
+        if(ref->kind == TRACE_FORK)
+            vmm_fork_cpu(full, ref->cpu, ref->asid, ref->child);
+        else
+            vmm_access_cpu(full, ref->cpu, ref->asid, ref->vaddr % config.virtualSize, ref->kind == TRACE_WRITE, &byte, NULL);
     }
-    
-    fprintf(stderr, "Could not read from frame at location %d.\n", addr->location);
-    return 0;
+    double fullTime = now() - fullStart, runTime = replayed - reduced;
+
+    reportStats(ctx);
+    VMM_STATS a, b;
+    vmm_get_stats(ctx, &a);
+    vmm_get_stats(full, &b);
+    double ratio = runs->count > 0 ? (double)runs->numRefs / runs->count : -1;
+    printf("Trace Runs = %ld (Compaction Ratio = %f)\n", runs->count, ratio);
+    printf("Reduction Time = %f s\n", reduced - start);
+    printf("Replay Time = %f s (Full Trace = %f s, Speedup = %f)\n", runTime, fullTime, runTime > 0 ? fullTime / runTime : -1);
+    printf("Replay Matches Full Trace = %s\n", memcmp(&a, &b, sizeof(VMM_STATS)) == 0 ? "yes" : "no");
+    vmm_destroy(full);
+    freeTraceRuns(runs);
+}
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
 }
 /*
  * Prints out the final statistics in percentage form.
  * Should there be 0/0, -1 will be reported.
  */
-static void reportStats() {
+static void reportStats(VMM_CTX *ctx) {
+    VMM_STATS stats;
+    vmm_get_stats(ctx, &stats);
     double pageFaultRate = -1;
-    if(numPageAccesses != 0)
-        pageFaultRate = ((double)numPageFaults)/numPageAccesses;
+    if(stats.pageAccesses != 0)
+        pageFaultRate = ((double)stats.pageFaults)/stats.pageAccesses;
     double TLBHitRate = -1;
-    if(numTLBLookups != 0)
-        TLBHitRate = ((double)numTLBHits)/numTLBLookups;
-    printf("Number of Translated Addresses = %d\n", numPageAccesses);
-    printf("Page Faults = %d\n", numPageFaults);
+    if(stats.tlbLookups != 0)
+        TLBHitRate = ((double)stats.tlbHits)/stats.tlbLookups;
+    printf("Number of Translated Addresses = %ld\n", stats.pageAccesses);
+    printf("Page Faults = %ld\n", stats.pageFaults);
     printf("Page Fault Rate = %f\n", pageFaultRate);
-    printf("TLB Hits = %d\n", numTLBHits);
+    printf("TLB Hits = %ld\n", stats.tlbHits);
     printf("TLB Hit Rate = %f\n", TLBHitRate);
+    if(stats.zswapStores + stats.zswapRejects > 0) {
+        double ratio = -1;
+        if(stats.zswapBytesOut != 0)
+            ratio = ((double)stats.zswapBytesIn)/stats.zswapBytesOut;
+        printf("Zswap Stores = %ld (Rejected = %ld, Evicted = %ld, Written Back = %ld)\n", stats.zswapStores, stats.zswapRejects, stats.zswapEvictions, stats.zswapWriteBacks);
+        printf("Zswap Compression Ratio = %f\n", ratio);
+        printf("Zswap Hits = %ld\n", stats.zswapHits);
+        printf("Backing Store Reads = %ld\n", stats.backingStoreReads);
+        printf("Swap Reads = %ld (Avoided = %ld)\n", stats.swapReads, stats.swapReadsAvoided);
+    }
+    if(stats.zeroFaults > 0) {
+        printf("Zero Page Faults = %ld\n", stats.zeroFaults);
+        printf("Zero Page Mappings = %ld (Broken by Writes = %ld)\n", stats.zeroMapped, stats.zeroCowFaults);
+    }
+    if(stats.dedupMerges + stats.cowFaults + stats.framesSaved + stats.swapWrites > 0) {
+        printf("Deduplicated Frames = %ld\n", stats.dedupMerges);
+        printf("Frames Saved = %ld (Shared Frames = %ld)\n", stats.framesSaved, stats.sharedFrames);
+        printf("COW Faults = %ld\n", stats.cowFaults);
+        printf("Swap Writes = %ld, Swap Reads = %ld\n", stats.swapWrites, stats.swapReads);
+    }
+    VMM_CONFIG config;
+    vmm_get_config(ctx, &config);
+    if(config.numCPUs > 1) {
+        printf("TLB Shootdowns = %ld (IPIs = %ld, Cycles = %ld)\n", stats.tlbShootdowns, stats.shootdownIPIs, stats.shootdownCycles);
+        for(int c=0; c<config.numCPUs; c++) {
+            VMM_CPU_STATS cpu;
+            vmm_get_cpu_stats(ctx, c, &cpu);
+            double hitRate = -1;
+            if(cpu.tlbLookups != 0)
+                hitRate = ((double)cpu.tlbHits)/cpu.tlbLookups;
+            printf("CPU %d: References = %ld, TLB Hit Rate = %f, IPIs Received = %ld\n", c, cpu.references, hitRate, cpu.ipisReceived);
+        }
+    }
+    if(config.numNodes > 1) {
+        long accesses = stats.localAccesses + stats.remoteAccesses;
+        printf("NUMA Local Accesses = %ld, Remote Accesses = %ld (Remote Ratio = %f)\n", stats.localAccesses,
+                stats.remoteAccesses, accesses != 0 ? ((double)stats.remoteAccesses)/accesses : -1);
+        printf("NUMA Migrations = %ld (Bytes = %ld, Failed = %ld)\n", stats.numaMigrations, stats.migrationBytes, stats.migrationFailures);
+    }
+    if(config.slowSize > 0) {
+        long fastAccesses = stats.pageAccesses - stats.slowAccesses;
+        printf("Fast Tier Accesses = %ld (%ld ns), Slow Tier Accesses = %ld (%ld ns)\n", fastAccesses,
+                stats.memoryTime - stats.slowTime, stats.slowAccesses, stats.slowTime);
+        printf("Promotions = %ld, Demotions = %ld\n", stats.promotions, stats.demotions);
+    }
+    if(config.numNodes > 1 || config.slowSize > 0) {
+        double perAccess = -1;
+        if(stats.pageAccesses != 0)
+            perAccess = ((double)stats.memoryTime)/stats.pageAccesses;
+        printf("Memory Time = %ld ns (%f ns/access)\n", stats.memoryTime, perAccess);
+        if(config.slowSize > 0) {
+            double slowdown = -1;
+            if(stats.dramOnlyTime != 0)
+                slowdown = ((double)stats.memoryTime)/stats.dramOnlyTime;
+            printf("Memory Time if DRAM Only = %ld ns (Slowdown = %f)\n", stats.dramOnlyTime, slowdown);
+        }
+    }
+    if(config.swapDevices > 0) {
+        long cpuTime = 0;
+        for(int c=0; c<config.numCPUs; c++) {
+            VMM_CPU_STATS cpu;
+            vmm_get_cpu_stats(ctx, c, &cpu);
+            cpuTime += cpu.clock;
+        }
+        double waiting = -1;
+        if(cpuTime != 0)
+            waiting = ((double)stats.swapWaitTime)/cpuTime;
+        printf("Elapsed Time = %ld ns, Swap Wait Time = %ld ns (Fraction of CPU Time = %f)\n", stats.elapsedTime, stats.swapWaitTime, waiting);
+        for(int d=0; d<config.swapDevices; d++) {
+            VMM_SWAP_STATS dev;
+            vmm_get_swap_stats(ctx, d, &dev);
+            double utilization = -1, delay = -1;
+            if(stats.elapsedTime != 0)
+                utilization = ((double)dev.busyTime)/stats.elapsedTime;
+            if(dev.served != 0)
+                delay = ((double)dev.queueDelay)/dev.served;
+            printf("Swap Device %d: Reads = %ld, Writes = %ld, Utilization = %f, Queue Delay = %f ns (Max = %ld ns), Full Queue Stalls = %ld\n",
+                    d, dev.reads, dev.writes, utilization, delay, dev.maxQueueDelay, dev.fullStalls);
+        }
+    }
 }
-
-static void pushPageLRU(PAGE *p) {
-    insertDLL(pageStack, 0, p);
+/*
+ * Reads the length of a telemetry interval: a number of references, a
+ * number of seconds followed by s, or both separated by a comma. Leaving
+ * either out turns that trigger off.
+ * Returns 0 on success, or -1 if the length is malformed.
+ */
+static int parseInterval(const char *spec, long *every, double *seconds) {
+    *every = 0;
+    *seconds = 0;
+    while(*spec != '\0') {
+        char *end;
+        double value = strtod(spec, &end);
+        if(end == spec || value <= 0)
+            return -1;
+        if(*end == 's') {
+            *seconds = value;
+            end++;
+        } else {
+            *every = (long)value;
+        }
+        if(*end == ',')
+            end++;
+        else if(*end != '\0')
+            return -1;
+        spec = end;
+    }
+    return *every > 0 || *seconds > 0 ? 0 : -1;
 }
-static void updatePageLRU(PAGE *p) {
-    int index = findDLL(pageStack, p);
-    if(index == -1)
-        fprintf(stderr, "Error in updatePageLRU; could not update the page.\n");
-    else
-        insertDLL(pageStack, 0, removeDLL(pageStack, index));
+/*
+ * Reads the NUMA nodes from a comma separated list of their sizes in bytes,
+ * each optionally followed by :latency in nanoseconds. Physical memory is
+ * the sum of the nodes.
+ * Returns 0 on success, or -1 if the list is malformed.
+ */
+static int parseNodes(VMM_CONFIG *config, char *spec) {
+    int n = 0;
+    unsigned int total = 0;
+    for(char *node = strtok(spec, ","); node != NULL; node = strtok(NULL, ",")) {
+        if(n == VMM_MAX_NODES)
+            return -1;
+        char *end;
+        config->nodeSize[n] = strtoul(node, &end, 0);
+        if(*end == ':')
+            config->nodeLatency[n] = strtol(end + 1, &end, 0);
+        if(*end != '\0' || config->nodeSize[n] == 0)
+            return -1;
+        total += config->nodeSize[n++];
+    }
+    if(n == 0)
+        return -1;
+    config->numNodes = n;
+    config->physicalSize = total;
+    return 0;
 }
-static PAGE *popPageLRU() {
-    return removeDLL(pageStack, sizeDLL(pageStack)-1);
+/*
+ * Reads the placement policy of new pages.
+ * Returns 0 on success, or -1 if it is not one of them.
+ */
+static int parsePolicy(VMM_CONFIG *config, const char *spec) {
+    if(strcmp(spec, "first-touch") == 0) {
+        config->numaPolicy = VMM_NUMA_FIRST_TOUCH;
+    } else if(strcmp(spec, "interleave") == 0) {
+        config->numaPolicy = VMM_NUMA_INTERLEAVE;
+    } else if(strncmp(spec, "preferred", 9) == 0 && (spec[9] == '\0' || spec[9] == ':')) {
+        config->numaPolicy = VMM_NUMA_PREFERRED;
+        config->preferredNode = spec[9] == ':' ? atoi(spec + 10) : 0;
+    } else {
+        return -1;
+    }
+    return 0;
 }
-
 /*
- * Adds a TLB entry to the table. Uses FIFO replacement, so the oldest entry will be replaced
- * if the table is full.
+ * Reads the scheduler of the swap devices, and for deadline optionally how
+ * long a read may wait.
+ * Returns 0 on success, or -1 if it is not one of them.
  */
-static void addTLBEntry(TLB_ENTRY *e) {
-    if(sizeTLB >= TLB_SIZE) {
-        if(oldestTLB >= TLB_SIZE)
-            oldestTLB = 0;
-        TLB_ENTRY *temp = tlb[oldestTLB];
-        tlb[oldestTLB++] = e;
-        free(temp);
+static int parseScheduler(VMM_CONFIG *config, const char *spec) {
+    if(strcmp(spec, "fifo") == 0) {
+        config->swapScheduler = VMM_IO_FIFO;
+    } else if(strcmp(spec, "elevator") == 0) {
+        config->swapScheduler = VMM_IO_ELEVATOR;
+    } else if(strncmp(spec, "deadline", 8) == 0 && (spec[8] == '\0' || spec[8] == ':')) {
+        config->swapScheduler = VMM_IO_DEADLINE;
+        if(spec[8] == ':')
+            config->swapDeadline = strtol(spec + 9, NULL, 0);
+    } else {
+        return -1;
     }
-    else
-        tlb[sizeTLB++] = e;
+    return 0;
 }
 /*
- * Searches for the given page number in the TLB table. If a match is found, the frame
- * number is returned. If no match is found, -1 is returned.
+ * Streams the input file through a(possibly sampled) LRU miss ratio curve
+ * instead of simulating it, then prints the curve over every frame count
+ * and the page faults it predicts for the configured number of frames.
+ * Closes the file(fp) after EOF is reached.
  */
-static int findTLBEntry(int pageNum) {
-    TLB_ENTRY *temp;
-    for(int i=0; i<sizeTLB; i++) {
-        temp = tlb[i];
-        if(temp->pageNum == pageNum)
-            return temp->frameNum;
+static void reportCurve(FILE *fp, const VMM_CONFIG *config, double rate, long maxSamples) {
+    MRC *curve = newMRC(rate, maxSamples);
+    TRACE_REF ref;
+    while(nextReference(fp, &ref)) {
+        if(ref.kind == TRACE_FORK)
+            continue;
+        uint64_t page = (ref.vaddr % config->virtualSize) / config->pageSize;
+        referenceMRC(curve, ((uint64_t)ref.asid << 32) | page);
+    }
+    fclose(fp);
+
+    MRC_STATS stats;
+    statsMRC(curve, &stats);
+    double error;
+    long maxFrames = framesMRC(curve);
+    for(long frames=1; frames<=maxFrames; frames++) {
+        double ratio = missRatioMRC(curve, frames, &error);
+        printf("Frames: %ld Miss Ratio: %f (+/- %f)\n", frames, ratio, error);
     }
-    return -1;
+    long numFrames = config->physicalSize / config->pageSize;
+    double ratio = missRatioMRC(curve, numFrames, &error);
+    printf("Number of Translated Addresses = %ld\n", stats.references);
+    printf("Page Faults = %ld\n", (long)(ratio * stats.references + 0.5));
+    printf("Page Fault Rate = %f (+/- %f)\n", ratio, error);
+    printf("Sample Rate = %f, Sampled References = %ld, Sampled Pages = %ld\n", stats.rate, stats.sampledReferences, stats.sampledPages);
+    freeMRC(curve);
 }
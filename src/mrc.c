@@ -0,0 +1,338 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <assert.h>
+#include "mrc.h"
+
+#define HASH_RANGE 9007199254740992.0   //2^53; hashes are compared on their top 53 bits
+#define MIN_TABLE 64
+#define MAX_BUCKETS (1L << 20)          //Histogram size before buckets start to widen
+
+/*
+ * A sampled page and the time(index among sampled references) of its last
+ * reference.
+ */
+typedef struct sample {
+    uint64_t key, hash;
+    long time;
+    int used;
+} SAMPLE;
+
+struct mrc {
+    uint64_t threshold;         //Pages whose hash is below this are sampled
+    long maxSamples;            //0 for a fixed rate
+
+    SAMPLE *table;              //Open addressing, linear probing
+    long tableSize, count;
+
+    SAMPLE *heap;               //Max-heap on hash, only kept when the sample set is capped
+    long heapSize;
+
+    int *tree;                  //Fenwick tree marking the times that are some page's last reference
+    long treeSize, clock;
+
+    double *histogram;          //Weighted references by scaled stack distance
+    long buckets, bucketWidth;
+    double cold;                //Weighted references to pages never seen before
+    double weight;              //Sum of every weight handed out
+
+    long references, sampledReferences;
+};
+
+static uint64_t mix64(uint64_t x);
+static SAMPLE *findSample(MRC *m, uint64_t key);
+static SAMPLE *insertSample(MRC *m, uint64_t key, uint64_t hash);
+static void deleteSample(MRC *m, uint64_t key);
+static void pushHeap(MRC *m, uint64_t key, uint64_t hash);
+static SAMPLE popHeap(MRC *m);
+static void addTree(MRC *m, long t, int delta);
+static long sumTree(MRC *m, long t);
+static void compactTimes(MRC *m);
+static void addHistogram(MRC *m, double distance, double weight);
+
+/*
+ * Creates an empty curve. rate is the fraction of pages to sample(0 to 1);
+ * if maxSamples is not 0, the sample set never holds more pages than that.
+ */
+MRC *newMRC(double rate, long maxSamples) {
+    MRC *m = malloc(sizeof(MRC));
+    assert(m != 0);
+
+    if(rate <= 0 || rate > 1)
+        rate = 1;
+    m->threshold = rate >= 1 ? (uint64_t)HASH_RANGE : (uint64_t)(rate * HASH_RANGE);
+    m->maxSamples = maxSamples > 0 ? maxSamples : 0;
+    m->tableSize = MIN_TABLE;
+    m->table = calloc(m->tableSize, sizeof(SAMPLE));
+    assert(m->table != 0);
+    m->count = 0;
+    m->heap = m->maxSamples ? malloc(sizeof(SAMPLE) * (m->maxSamples + 1)) : NULL;
+    m->heapSize = 0;
+    m->treeSize = MIN_TABLE;
+    m->tree = calloc(m->treeSize + 1, sizeof(int));
+    assert(m->tree != 0);
+    m->clock = 0;
+    m->buckets = MIN_TABLE;
+    m->histogram = calloc(m->buckets, sizeof(double));
+    assert(m->histogram != 0);
+    m->bucketWidth = 1;
+    m->cold = 0;
+    m->weight = 0;
+    m->references = 0;
+    m->sampledReferences = 0;
+    return m;
+}
+/*
+ * Feeds one reference to the page identified by key.
+ */
+void referenceMRC(MRC *m, uint64_t key) {
+    m->references++;
+    uint64_t hash = mix64(key) >> 11;
+    if(hash >= m->threshold)
+        return;
+    m->sampledReferences++;
+    double rate = m->threshold / HASH_RANGE;
+    double weight = 1 / rate;
+    m->weight += weight;
+
+    if(m->clock >= m->treeSize)
+        compactTimes(m);
+    SAMPLE *s = findSample(m, key);
+    if(s != NULL) {
+        long distance = sumTree(m, m->clock) - sumTree(m, s->time);  //Pages referenced since
+        addHistogram(m, distance / rate, weight);
+        addTree(m, s->time, -1);
+        s->time = ++m->clock;
+        addTree(m, s->time, 1);
+        return;
+    }
+
+    m->cold += weight;
+    s = insertSample(m, key, hash);
+    s->time = ++m->clock;
+    addTree(m, s->time, 1);
+    if(m->maxSamples == 0)
+        return;
+    pushHeap(m, key, hash);
+    if(m->count > m->maxSamples) {  //Lower the threshold below the largest sampled hash
+        SAMPLE evicted = popHeap(m);
+        SAMPLE *e = findSample(m, evicted.key);
+        addTree(m, e->time, -1);
+        deleteSample(m, evicted.key);
+        m->threshold = evicted.hash;
+    }
+}
+/*
+ * Returns the number of frames past which the curve stays flat(every miss
+ * is a cold one).
+ */
+long framesMRC(MRC *m) {
+    long last = 0;
+    for(long i=0; i<m->buckets; i++) {
+        if(m->histogram[i] != 0)
+            last = i;
+    }
+    long frames = (last + 1) * m->bucketWidth;
+    long distinct = (long)ceil(m->cold);
+    return frames > distinct ? frames : distinct;
+}
+/*
+ * Returns the estimated miss ratio of an LRU memory with the given number of
+ * frames, and stores in error(if not NULL) the half-width of an approximate
+ * 95% confidence interval around it. The weights are normalized so they add
+ * up to the number of references actually made.
+ */
+double missRatioMRC(MRC *m, long frames, double *error) {
+    if(error)
+        *error = 0;
+    if(m->references == 0)
+        return -1;
+    double misses = m->cold;
+    for(long i=0; i<m->buckets; i++) {
+        long low = i * m->bucketWidth, high = low + m->bucketWidth;
+        if(low >= frames)
+            misses += m->histogram[i];
+        else if(high > frames)  //Partially covered bucket
+            misses += m->histogram[i] * (double)(high - frames) / m->bucketWidth;
+    }
+    double total = m->weight;
+    if(total < m->references)
+        total = m->references;  //Missing weight goes to the shortest distance(hits)
+    double ratio = misses / total;
+    if(ratio > 1)
+        ratio = 1;
+    if(error && m->threshold < (uint64_t)HASH_RANGE) {
+        long pages = m->count > 0 ? m->count : 1;
+        *error = 1.96 * sqrt(ratio * (1 - ratio) / pages);
+    }
+    return ratio;
+}
+void statsMRC(MRC *m, MRC_STATS *stats) {
+    stats->references = m->references;
+    stats->sampledReferences = m->sampledReferences;
+    stats->sampledPages = m->count;
+    stats->rate = m->threshold / HASH_RANGE;
+}
+void freeMRC(MRC *m) {
+    free(m->table);
+    free(m->heap);
+    free(m->tree);
+    free(m->histogram);
+    free(m);
+}
+
+/*
+ * Spreads the bits of a key evenly(the splitmix64 finalizer).
+ */
+static uint64_t mix64(uint64_t x) {
+    x += 0x9E3779B97F4A7C15ULL;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+static SAMPLE *findSample(MRC *m, uint64_t key) {
+    long i = (long)(mix64(key ^ 0x5bd1e995) & (uint64_t)(m->tableSize - 1));
+    while(m->table[i].used) {
+        if(m->table[i].key == key)
+            return &m->table[i];
+        i = (i + 1) & (m->tableSize - 1);
+    }
+    return NULL;
+}
+static SAMPLE *insertSample(MRC *m, uint64_t key, uint64_t hash) {
+    if((m->count + 1) * 2 > m->tableSize) {     //Keep the table at most half full
+        SAMPLE *old = m->table;
+        long oldSize = m->tableSize;
+        m->tableSize *= 2;
+        m->table = calloc(m->tableSize, sizeof(SAMPLE));
+        assert(m->table != 0);
+        m->count = 0;
+        for(long i=0; i<oldSize; i++) {
+            if(old[i].used)
+                insertSample(m, old[i].key, old[i].hash)->time = old[i].time;
+        }
+        free(old);
+    }
+    long i = (long)(mix64(key ^ 0x5bd1e995) & (uint64_t)(m->tableSize - 1));
+    while(m->table[i].used)
+        i = (i + 1) & (m->tableSize - 1);
+    m->table[i].key = key;
+    m->table[i].hash = hash;
+    m->table[i].time = 0;
+    m->table[i].used = 1;
+    m->count++;
+    return &m->table[i];
+}
+/*
+ * Removes a key, shifting later entries of its probe run back so lookups
+ * never need tombstones.
+ */
+static void deleteSample(MRC *m, uint64_t key) {
+    long mask = m->tableSize - 1;
+    long i = (long)(mix64(key ^ 0x5bd1e995) & (uint64_t)mask);
+    while(m->table[i].used && m->table[i].key != key)
+        i = (i + 1) & mask;
+    if(!m->table[i].used)
+        return;
+    m->table[i].used = 0;
+    m->count--;
+    for(long j = (i + 1) & mask; m->table[j].used; j = (j + 1) & mask) {
+        long home = (long)(mix64(m->table[j].key ^ 0x5bd1e995) & (uint64_t)mask);
+        //Move j into the hole at i if its home is not cyclically within (i, j]
+        if((j > i && (home <= i || home > j)) || (j < i && (home <= i && home > j))) {
+            m->table[i] = m->table[j];
+            m->table[j].used = 0;
+            i = j;
+        }
+    }
+}
+static void pushHeap(MRC *m, uint64_t key, uint64_t hash) {
+    long i = m->heapSize++;
+    while(i > 0 && m->heap[(i-1)/2].hash < hash) {
+        m->heap[i] = m->heap[(i-1)/2];
+        i = (i-1)/2;
+    }
+    m->heap[i].key = key;
+    m->heap[i].hash = hash;
+}
+static SAMPLE popHeap(MRC *m) {
+    SAMPLE top = m->heap[0], last = m->heap[--m->heapSize];
+    long i = 0;
+    for(;;) {
+        long child = 2*i + 1;
+        if(child >= m->heapSize)
+            break;
+        if(child + 1 < m->heapSize && m->heap[child+1].hash > m->heap[child].hash)
+            child++;
+        if(m->heap[child].hash <= last.hash)
+            break;
+        m->heap[i] = m->heap[child];
+        i = child;
+    }
+    m->heap[i] = last;
+    return top;
+}
+static void addTree(MRC *m, long t, int delta) {
+    for(; t <= m->treeSize; t += t & -t)
+        m->tree[t] += delta;
+}
+static long sumTree(MRC *m, long t) {
+    long sum = 0;
+    for(; t > 0; t -= t & -t)
+        sum += m->tree[t];
+    return sum;
+}
+static int compareTimes(const void *a, const void *b) {
+    long x = (*(SAMPLE * const *)a)->time, y = (*(SAMPLE * const *)b)->time;
+    return (x > y) - (x < y);
+}
+/*
+ * Renumbers the last reference times of the sampled pages to 1..count once
+ * the clock runs off the end of the tree, so the tree stays proportional to
+ * the sample set instead of the trace.
+ */
+static void compactTimes(MRC *m) {
+    SAMPLE **live = malloc(sizeof(SAMPLE *) * (m->count + 1));
+    assert(live != 0);
+    long n = 0;
+    for(long i=0; i<m->tableSize; i++) {
+        if(m->table[i].used)
+            live[n++] = &m->table[i];
+    }
+    qsort(live, n, sizeof(SAMPLE *), &compareTimes);
+    if(m->treeSize < 4 * n + MIN_TABLE)
+        m->treeSize = 4 * n + MIN_TABLE;
+    free(m->tree);
+    m->tree = calloc(m->treeSize + 1, sizeof(int));
+    assert(m->tree != 0);
+    for(long i=0; i<n; i++) {
+        live[i]->time = i + 1;
+        addTree(m, i + 1, 1);
+    }
+    m->clock = n;
+    free(live);
+}
+/*
+ * Adds weight at a stack distance, growing the histogram(or widening its
+ * buckets once it reaches MAX_BUCKETS) as needed.
+ */
+static void addHistogram(MRC *m, double distance, double weight) {
+    long bucket = (long)(distance / m->bucketWidth);
+    while(bucket >= m->buckets) {
+        if(m->buckets < MAX_BUCKETS) {
+            long grown = m->buckets * 2;
+            m->histogram = realloc(m->histogram, sizeof(double) * grown);
+            assert(m->histogram != 0);
+            memset(m->histogram + m->buckets, 0, sizeof(double) * (grown - m->buckets));
+            m->buckets = grown;
+        } else {
+            for(long i=0; i<m->buckets/2; i++)
+                m->histogram[i] = m->histogram[2*i] + m->histogram[2*i+1];
+            memset(m->histogram + m->buckets/2, 0, sizeof(double) * (m->buckets/2));
+            m->bucketWidth *= 2;
+        }
+        bucket = (long)(distance / m->bucketWidth);
+    }
+    m->histogram[bucket] += weight;
+}
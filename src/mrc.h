@@ -0,0 +1,30 @@
+#ifndef MRC_H
+#define MRC_H
+
+#include <stdint.h>
+
+/*
+ * Approximate LRU miss ratio curves through spatially hashed sampling(SHARDS).
+ * A page is sampled when the hash of its key falls below a threshold, so
+ * every reference to a sampled page is seen and stack distances among the
+ * sampled pages can be scaled up by the sampling rate. The sample set is
+ * either unbounded with a fixed rate, or capped at a number of pages, in
+ * which case the threshold(and so the rate) drops whenever it overflows.
+ * A rate of 1 gives the exact curve.
+ */
+typedef struct mrc MRC;
+
+typedef struct mrc_stats {
+    long references, sampledReferences;
+    long sampledPages;      //Pages currently in the sample set
+    double rate;            //Current sampling rate
+} MRC_STATS;
+
+extern MRC *newMRC(double rate, long maxSamples);
+extern void referenceMRC(MRC *m, uint64_t key);
+extern long framesMRC(MRC *m);
+extern double missRatioMRC(MRC *m, long frames, double *error);
+extern void statsMRC(MRC *m, MRC_STATS *stats);
+extern void freeMRC(MRC *m);
+
+#endif
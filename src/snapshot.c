@@ -0,0 +1,41 @@
+#include <stdio.h>
+#include <string.h>
+#include "snapshot.h"
+
+void writeSnapshotI32(FILE *fp, int32_t v) {
+    fwrite(&v, sizeof(v), 1, fp);
+}
+void writeSnapshotI64(FILE *fp, int64_t v) {
+    fwrite(&v, sizeof(v), 1, fp);
+}
+void writeSnapshotBytes(FILE *fp, const void *data, size_t size) {
+    fwrite(data, 1, size, fp);
+}
+
+int32_t readSnapshotI32(SNAPSHOT_READER *r) {
+    int32_t v = 0;
+    const void *p = readSnapshotBytes(r, sizeof(v));
+    if(p)
+        memcpy(&v, p, sizeof(v));
+    return v;
+}
+int64_t readSnapshotI64(SNAPSHOT_READER *r) {
+    int64_t v = 0;
+    const void *p = readSnapshotBytes(r, sizeof(v));
+    if(p)
+        memcpy(&v, p, sizeof(v));
+    return v;
+}
+/*
+ * Returns a pointer to the next size bytes, or NULL(setting the error flag)
+ * if there are not that many left.
+ */
+const void *readSnapshotBytes(SNAPSHOT_READER *r, size_t size) {
+    if(r->error || (size_t)(r->end - r->pos) < size) {
+        r->error = 1;
+        return NULL;
+    }
+    const void *p = r->pos;
+    r->pos += size;
+    return p;
+}
@@ -0,0 +1,27 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Helpers for the binary checkpoint files. Values are written with fixed
+ * widths in host byte order; a checkpoint is read back from memory(usually
+ * an mmap of the file) through a SNAPSHOT_READER, which flags any read past
+ * the end instead of failing outright.
+ */
+typedef struct snapshot_reader {
+    const unsigned char *pos, *end;
+    int error;
+} SNAPSHOT_READER;
+
+extern void writeSnapshotI32(FILE *fp, int32_t v);
+extern void writeSnapshotI64(FILE *fp, int64_t v);
+extern void writeSnapshotBytes(FILE *fp, const void *data, size_t size);
+
+extern int32_t readSnapshotI32(SNAPSHOT_READER *r);
+extern int64_t readSnapshotI64(SNAPSHOT_READER *r);
+extern const void *readSnapshotBytes(SNAPSHOT_READER *r, size_t size);
+
+#endif
@@ -0,0 +1,256 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "swapdev.h"
+
+#define WRITE_DEADLINE_FACTOR 10    //Writes may wait this many times longer than reads under VMM_IO_DEADLINE
+
+/*
+ * One request waiting in a device's queue.
+ */
+typedef struct swap_request {
+    long id;            //Order of submission across every device
+    long block;         //Block on its device
+    long arrival;       //Time it joined the queue
+    long deadline;      //Time VMM_IO_DEADLINE serves it by, if it can
+    int write;
+} SWAP_REQUEST;
+
+/*
+ * A device serves one request at a time. Requests are only taken off the
+ * queue when something needs to know when they finish, so the queue can
+ * hold requests that the device would already have started by then; the
+ * choice of each is made among those that had arrived by the time it starts.
+ */
+typedef struct swap_device {
+    SWAP_REQUEST *queue;    //Waiting requests, in order of submission
+    int count;
+    long head;              //Block the last request was served at
+    int down;               //Whether the elevator is sweeping toward lower blocks
+    long free;              //Time the last request served finishes
+    VMM_SWAP_STATS stats;
+} SWAP_DEVICE;
+
+struct swap_devices {
+    int numDevices, stripe, depth, scheduler;
+    long latency, seek, deadline;
+    long span;              //Blocks on each device
+    long nextId;
+    SWAP_DEVICE *devices;
+};
+
+static long nextStart(SWAP_DEVICE *d);
+static int pickRequest(SWAP_DEVICES *s, SWAP_DEVICE *d, long start);
+static long dispatch(SWAP_DEVICES *s, SWAP_DEVICE *d, long *done);
+
+/*
+ * Creates numDevices idle devices that numBlocks blocks(pages) are striped
+ * over, stripe blocks at a time. Each queue holds up to depth requests.
+ * latency is the time to serve any request, seek that of moving across the
+ * whole device, and deadline how long a read may wait under VMM_IO_DEADLINE.
+ */
+SWAP_DEVICES *newSwapDevices(int numDevices, long numBlocks, int stripe, int depth, int scheduler,
+        long latency, long seek, long deadline) {
+    SWAP_DEVICES *s = malloc(sizeof(SWAP_DEVICES));
+    assert(s != 0);
+
+    s->numDevices = numDevices;
+    s->stripe = stripe;
+    s->depth = depth;
+    s->scheduler = scheduler;
+    s->latency = latency;
+    s->seek = seek;
+    s->deadline = deadline;
+    long units = (numBlocks + stripe - 1) / stripe;
+    s->span = (units + numDevices - 1) / numDevices * stripe;
+    s->nextId = 0;
+    s->devices = calloc(numDevices, sizeof(SWAP_DEVICE));
+    assert(s->devices != 0);
+    for(int i=0; i<numDevices; i++) {
+        s->devices[i].queue = malloc(sizeof(SWAP_REQUEST) * depth);
+        assert(s->devices[i].queue != 0);
+    }
+    return s;
+}
+/*
+ * Queues a read or write of the given block at time now, first waiting for
+ * room if the device's queue is full. A read is then followed through to its
+ * end, serving whatever the scheduler puts before it; a write is left in the
+ * queue.
+ * Returns the time the submitter may go on: when the read has finished, or
+ * when the write joined the queue.
+ */
+long submitSwap(SWAP_DEVICES *s, long now, long block, int write) {
+    long unit = block / s->stripe, done;
+    SWAP_DEVICE *d = &s->devices[unit % s->numDevices];
+    while(d->count > 0 && nextStart(d) <= now)  //Catches the device up to now
+        dispatch(s, d, &done);
+    long at = now;
+    if(d->count >= s->depth) {
+        at = nextStart(d);
+        dispatch(s, d, &done);
+        d->stats.fullStalls++;
+    }
+
+    SWAP_REQUEST *r = &d->queue[d->count++];
+    r->id = s->nextId++;
+    r->block = unit / s->numDevices * s->stripe + block % s->stripe;
+    r->arrival = at;
+    r->deadline = at + s->deadline * (write ? WRITE_DEADLINE_FACTOR : 1);
+    r->write = write;
+    if(write) {
+        d->stats.writes++;
+        return at;
+    }
+    d->stats.reads++;
+    long id = r->id;
+    while(dispatch(s, d, &done) != id)
+        ;
+    return done;
+}
+void statsSwapDevice(SWAP_DEVICES *s, int device, VMM_SWAP_STATS *stats) {
+    *stats = s->devices[device].stats;
+}
+/*
+ * Writes the state of every device, with its queue and statistics, to a
+ * checkpoint.
+ */
+void saveSwapDevices(SWAP_DEVICES *s, FILE *fp) {
+    writeSnapshotI64(fp, s->nextId);
+    for(int i=0; i<s->numDevices; i++) {
+        SWAP_DEVICE *d = &s->devices[i];
+        writeSnapshotI64(fp, d->head);
+        writeSnapshotI32(fp, d->down);
+        writeSnapshotI64(fp, d->free);
+        writeSnapshotI32(fp, d->count);
+        for(int q=0; q<d->count; q++) {
+            writeSnapshotI64(fp, d->queue[q].id);
+            writeSnapshotI64(fp, d->queue[q].block);
+            writeSnapshotI64(fp, d->queue[q].arrival);
+            writeSnapshotI64(fp, d->queue[q].deadline);
+            writeSnapshotI32(fp, d->queue[q].write);
+        }
+        const long *counters = (const long *)&d->stats;
+        for(size_t c=0; c<sizeof(VMM_SWAP_STATS)/sizeof(long); c++)
+            writeSnapshotI64(fp, counters[c]);
+    }
+}
+/*
+ * Restores idle devices from a checkpoint written by saveSwapDevices.
+ * Returns 0 on success, or -1 if the checkpoint does not fit these devices.
+ */
+int restoreSwapDevices(SWAP_DEVICES *s, SNAPSHOT_READER *r) {
+    s->nextId = (long)readSnapshotI64(r);
+    for(int i=0; i<s->numDevices && !r->error; i++) {
+        SWAP_DEVICE *d = &s->devices[i];
+        d->head = (long)readSnapshotI64(r);
+        d->down = readSnapshotI32(r);
+        d->free = (long)readSnapshotI64(r);
+        d->count = readSnapshotI32(r);
+        if(d->count < 0 || d->count > s->depth) {
+            d->count = 0;
+            return -1;
+        }
+        for(int q=0; q<d->count; q++) {
+            d->queue[q].id = (long)readSnapshotI64(r);
+            d->queue[q].block = (long)readSnapshotI64(r);
+            d->queue[q].arrival = (long)readSnapshotI64(r);
+            d->queue[q].deadline = (long)readSnapshotI64(r);
+            d->queue[q].write = readSnapshotI32(r);
+            if(d->queue[q].block < 0 || d->queue[q].block >= s->span)
+                return -1;
+        }
+        long *counters = (long *)&d->stats;
+        for(size_t c=0; c<sizeof(VMM_SWAP_STATS)/sizeof(long); c++)
+            counters[c] = (long)readSnapshotI64(r);
+    }
+    return r->error ? -1 : 0;
+}
+void freeSwapDevices(SWAP_DEVICES *s) {
+    for(int i=0; i<s->numDevices; i++)
+        free(s->devices[i].queue);
+    free(s->devices);
+    free(s);
+}
+
+/*
+ * Returns the time the device can start its next request: once the last one
+ * has finished, and not before the first waiting request arrived.
+ */
+static long nextStart(SWAP_DEVICE *d) {
+    long first = d->queue[0].arrival;
+    for(int i=1; i<d->count; i++) {
+        if(d->queue[i].arrival < first)
+            first = d->queue[i].arrival;
+    }
+    return first > d->free ? first : d->free;
+}
+/*
+ * Chooses the next request to serve among those that arrived by start.
+ * FIFO takes the earliest submitted. The elevator(LOOK) takes the nearest
+ * block in the direction it is sweeping, turning round when there is none.
+ * Deadline takes the earliest expired deadline, if any has, and otherwise
+ * does what the elevator does.
+ * Returns the request's place in the queue.
+ */
+static int pickRequest(SWAP_DEVICES *s, SWAP_DEVICE *d, long start) {
+    if(s->scheduler == VMM_IO_FIFO) {
+        for(int i=0; i<d->count; i++) {
+            if(d->queue[i].arrival <= start)
+                return i;
+        }
+    }
+    if(s->scheduler == VMM_IO_DEADLINE) {
+        int expired = -1;
+        for(int i=0; i<d->count; i++) {
+            if(d->queue[i].arrival <= start && d->queue[i].deadline <= start
+                    && (expired == -1 || d->queue[i].deadline < d->queue[expired].deadline))
+                expired = i;
+        }
+        if(expired != -1)
+            return expired;
+    }
+    for(int turn=0; turn<2; turn++) {
+        int best = -1;
+        long bestDistance = 0;
+        for(int i=0; i<d->count; i++) {
+            long distance = d->down ? d->head - d->queue[i].block : d->queue[i].block - d->head;
+            if(d->queue[i].arrival <= start && distance >= 0 && (best == -1 || distance < bestDistance)) {
+                best = i;
+                bestDistance = distance;
+            }
+        }
+        if(best != -1)
+            return best;
+        d->down = !d->down;
+    }
+    fprintf(stderr, "Error in pickRequest; no request had arrived by %ld.\n", start);
+    exit(-6);   //Fatal error - nextStart waits for the first arrival
+}
+/*
+ * Serves the next request of a device, which must have one waiting. The time
+ * it finishes is stored in done.
+ * Returns the request's id.
+ */
+static long dispatch(SWAP_DEVICES *s, SWAP_DEVICE *d, long *done) {
+    long start = nextStart(d);
+    int i = pickRequest(s, d, start);
+    SWAP_REQUEST r = d->queue[i];
+    memmove(&d->queue[i], &d->queue[i+1], sizeof(SWAP_REQUEST) * (d->count - i - 1));
+    d->count--;
+
+    long distance = r.block > d->head ? r.block - d->head : d->head - r.block;
+    long service = s->latency + (s->span > 1 ? s->seek * distance / (s->span - 1) : 0);
+    long wait = start - r.arrival;
+    d->head = r.block;
+    d->free = start + service;
+    d->stats.served++;
+    d->stats.busyTime += service;
+    d->stats.seekDistance += distance;
+    d->stats.queueDelay += wait;
+    if(wait > d->stats.maxQueueDelay)
+        d->stats.maxQueueDelay = wait;
+    *done = d->free;
+    return r.id;
+}
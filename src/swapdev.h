@@ -0,0 +1,26 @@
+#ifndef SWAPDEV_H
+#define SWAPDEV_H
+
+#include <stdio.h>
+#include "vmm.h"
+#include "snapshot.h"
+
+/*
+ * A timing model of the swap space as one or more devices. Pages are striped
+ * over the devices a stripe unit at a time, and each device holds a queue of
+ * waiting requests that its scheduler(VMM_IO_* from vmm.h) serves one at a
+ * time. Serving a request takes a fixed latency plus a seek proportional to
+ * the distance from the last block served. Times are in nanoseconds on the
+ * clocks of whoever submits the requests.
+ */
+typedef struct swap_devices SWAP_DEVICES;
+
+extern SWAP_DEVICES *newSwapDevices(int numDevices, long numBlocks, int stripe, int depth, int scheduler,
+        long latency, long seek, long deadline);
+extern long submitSwap(SWAP_DEVICES *s, long now, long block, int write);
+extern void statsSwapDevice(SWAP_DEVICES *s, int device, VMM_SWAP_STATS *stats);
+extern void saveSwapDevices(SWAP_DEVICES *s, FILE *fp);
+extern int restoreSwapDevices(SWAP_DEVICES *s, SNAPSHOT_READER *r);
+extern void freeSwapDevices(SWAP_DEVICES *s);
+
+#endif
@@ -0,0 +1,153 @@
+#define _POSIX_C_SOURCE 200809L  //For clock_gettime and SIGPIPE
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <signal.h>
+#include <time.h>
+#include "telemetry.h"
+
+#define CLOCK_CHECK 1024    //References between looks at the clock when reporting by time
+
+/*
+ * The counters at the end of an interval. Rates over a run of intervals are
+ * the differences between two of these.
+ */
+typedef struct sample {
+    long references, faults, tlbLookups, tlbHits;
+    double time;
+} SAMPLE;
+
+struct telemetry {
+    FILE *fp;
+    long every;             //References per interval(0 to report by time only)
+    double seconds;         //Seconds per interval(0 to report by references only)
+    long sinceReport, sinceClock;
+    long intervals;
+    double start;
+    SAMPLE *samples;        //The last window+1 interval ends, oldest overwritten first
+    int window;
+};
+
+static double now(void);
+static void sampleStats(VMM_CTX *ctx, SAMPLE *s, VMM_STATS *stats);
+static void report(TELEMETRY *t, VMM_CTX *ctx);
+static double ratio(long part, long whole);
+
+/*
+ * Opens the output(a file or a FIFO, which blocks until a reader opens it).
+ * A report is due every given number of references and every given number
+ * of seconds, whichever comes first; either may be 0 to leave it out. The
+ * sliding window covers the given number of intervals. The first interval
+ * starts from the instance's counters as they are now.
+ * Returns NULL if the output could not be opened.
+ */
+TELEMETRY *newTelemetry(VMM_CTX *ctx, const char *path, long every, double seconds, int window) {
+    FILE *fp = fopen(path, "w");
+    if(fp == NULL) {
+        fprintf(stderr, "Telemetry %s could not be written to.\n", path);
+        return NULL;
+    }
+    signal(SIGPIPE, SIG_IGN);   //A reader that goes away is a write error, not the end of the replay
+    TELEMETRY *t = malloc(sizeof(TELEMETRY));
+    assert(t != 0);
+    t->fp = fp;
+    t->every = every;
+    t->seconds = seconds;
+    t->sinceReport = 0;
+    t->sinceClock = 0;
+    t->intervals = 0;
+    t->window = window > 0 ? window : 1;
+    t->samples = calloc(t->window + 1, sizeof(SAMPLE));
+    assert(t->samples != 0);
+    VMM_STATS stats;
+    sampleStats(ctx, &t->samples[0], &stats);  //A resumed replay starts from its checkpoint's counters
+    t->start = t->samples[0].time;
+    return t;
+}
+/*
+ * Counts references made since the last call, and reports an interval if
+ * one is due. Only reads the instance's counters when it is.
+ */
+void tickTelemetry(TELEMETRY *t, VMM_CTX *ctx, long refs) {
+    if(t->fp == NULL)
+        return;
+    t->sinceReport += refs;
+    if(t->every > 0 && t->sinceReport >= t->every) {
+        report(t, ctx);
+        return;
+    }
+    if(t->seconds > 0 && (t->sinceClock += refs) >= CLOCK_CHECK) {
+        t->sinceClock = 0;
+        if(now() - t->samples[t->intervals % (t->window + 1)].time >= t->seconds)
+            report(t, ctx);
+    }
+}
+/*
+ * Reports the last(partial) interval, if it made any references, and
+ * closes the output.
+ */
+void freeTelemetry(TELEMETRY *t, VMM_CTX *ctx) {
+    if(t->fp != NULL) {
+        if(t->sinceReport > 0)
+            report(t, ctx);
+        if(t->fp != NULL)
+            fclose(t->fp);
+    }
+    free(t->samples);
+    free(t);
+}
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+static void sampleStats(VMM_CTX *ctx, SAMPLE *s, VMM_STATS *stats) {
+    vmm_get_stats(ctx, stats);
+    s->references = stats->pageAccesses;
+    s->faults = stats->pageFaults;
+    s->tlbLookups = stats->tlbLookups;
+    s->tlbHits = stats->tlbHits;
+    s->time = now();
+}
+/*
+ * Ends the current interval and writes its line. Should the write fail(for
+ * instance because the FIFO's reader went away), reporting stops.
+ */
+static void report(TELEMETRY *t, VMM_CTX *ctx) {
+    int slots = t->window + 1;
+    long from = t->intervals + 1 - t->window;   //Start of the window
+    if(from < 0)
+        from = 0;
+    const SAMPLE *last = &t->samples[t->intervals % slots], *first = &t->samples[from % slots];
+    SAMPLE *cur = &t->samples[(t->intervals + 1) % slots];
+    VMM_STATS stats;
+    sampleStats(ctx, cur, &stats);
+    t->intervals++;
+    t->sinceReport = 0;
+    t->sinceClock = 0;
+
+    double elapsed = cur->time - last->time, windowElapsed = cur->time - first->time;
+    fprintf(t->fp, "{\"interval\":%ld,\"time\":%.6f,\"references\":%ld,\"interval_references\":%ld,"
+            "\"fault_rate\":%.6f,\"tlb_hit_rate\":%.6f,\"refs_per_sec\":%.1f,"
+            "\"window_intervals\":%ld,\"window_fault_rate\":%.6f,\"window_tlb_hit_rate\":%.6f,\"window_refs_per_sec\":%.1f,"
+            "\"resident_frames\":%ld,\"page_faults\":%ld}\n",
+            t->intervals, cur->time - t->start,
+            cur->references, cur->references - last->references,
+            ratio(cur->faults - last->faults, cur->references - last->references),
+            ratio(cur->tlbHits - last->tlbHits, cur->tlbLookups - last->tlbLookups),
+            elapsed > 0 ? (cur->references - last->references) / elapsed : 0,
+            t->intervals - from,
+            ratio(cur->faults - first->faults, cur->references - first->references),
+            ratio(cur->tlbHits - first->tlbHits, cur->tlbLookups - first->tlbLookups),
+            windowElapsed > 0 ? (cur->references - first->references) / windowElapsed : 0,
+            stats.residentFrames, stats.pageFaults);
+    if(fflush(t->fp) != 0 || ferror(t->fp)) {
+        fprintf(stderr, "Telemetry could not be written; no more will be reported.\n");
+        fclose(t->fp);
+        t->fp = NULL;
+    }
+}
+static double ratio(long part, long whole) {
+    return whole > 0 ? (double)part / whole : 0;
+}
@@ -0,0 +1,20 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include "vmm.h"
+
+/*
+ * Interval telemetry of a running replay. Every so many references, or so
+ * many seconds of wall time, one JSON object is written on a line of its own
+ * with the fault rate, TLB hit rate and throughput of that interval and of a
+ * sliding window of the last few intervals, plus the resident set size.
+ * Each line is flushed as it is written, so the output can be a FIFO that
+ * another program watches while the replay runs.
+ */
+typedef struct telemetry TELEMETRY;
+
+extern TELEMETRY *newTelemetry(VMM_CTX *ctx, const char *path, long every, double seconds, int window);
+extern void tickTelemetry(TELEMETRY *t, VMM_CTX *ctx, long refs);
+extern void freeTelemetry(TELEMETRY *t, VMM_CTX *ctx);
+
+#endif
@@ -0,0 +1,205 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include "tlb.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define TLB_X86 1
+#include <immintrin.h>
+#endif
+
+#define TLB_LANES 32    //Arrays are padded to a multiple of the widest search block
+
+struct tlb {
+    int32_t *tags;      //Padded with -1 so searches never need a scalar tail
+    int *frames;
+    int size, count, oldest;
+    int padded;         //count rounded up to TLB_LANES
+    int kind;
+    int (*search)(const int32_t *tags, int n, int32_t tag);
+};
+
+static int searchScalar(const int32_t *tags, int n, int32_t tag) {
+    for(int i=0; i<n; i++) {
+        if(tags[i] == tag)
+            return i;
+    }
+    return -1;
+}
+#ifdef TLB_X86
+/*
+ * The SIMD searches compare a whole block of tags before branching, so a
+ * large TLB costs few mispredicted branches. Only a block with a hit is
+ * looked at more closely.
+ */
+__attribute__((target("sse2")))
+static int searchSSE2(const int32_t *tags, int n, int32_t tag) {
+    __m128i key = _mm_set1_epi32(tag);
+    for(int i=0; i<n; i+=16) {
+        __m128i a = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i *)(tags + i)), key);
+        __m128i b = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i *)(tags + i + 4)), key);
+        __m128i c = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i *)(tags + i + 8)), key);
+        __m128i d = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i *)(tags + i + 12)), key);
+        __m128i any = _mm_or_si128(_mm_or_si128(a, b), _mm_or_si128(c, d));
+        if(_mm_movemask_epi8(any) == 0)
+            continue;
+        int mask = _mm_movemask_ps(_mm_castsi128_ps(a)) | (_mm_movemask_ps(_mm_castsi128_ps(b)) << 4)
+                | (_mm_movemask_ps(_mm_castsi128_ps(c)) << 8) | (_mm_movemask_ps(_mm_castsi128_ps(d)) << 12);
+        return i + __builtin_ctz(mask);
+    }
+    return -1;
+}
+__attribute__((target("avx2")))
+static int searchAVX2(const int32_t *tags, int n, int32_t tag) {
+    __m256i key = _mm256_set1_epi32(tag);
+    for(int i=0; i<n; i+=32) {
+        __m256i a = _mm256_cmpeq_epi32(_mm256_loadu_si256((const __m256i *)(tags + i)), key);
+        __m256i b = _mm256_cmpeq_epi32(_mm256_loadu_si256((const __m256i *)(tags + i + 8)), key);
+        __m256i c = _mm256_cmpeq_epi32(_mm256_loadu_si256((const __m256i *)(tags + i + 16)), key);
+        __m256i d = _mm256_cmpeq_epi32(_mm256_loadu_si256((const __m256i *)(tags + i + 24)), key);
+        __m256i any = _mm256_or_si256(_mm256_or_si256(a, b), _mm256_or_si256(c, d));
+        if(_mm256_testz_si256(any, any))
+            continue;
+        uint32_t mask = (uint32_t)_mm256_movemask_ps(_mm256_castsi256_ps(a))
+                | ((uint32_t)_mm256_movemask_ps(_mm256_castsi256_ps(b)) << 8)
+                | ((uint32_t)_mm256_movemask_ps(_mm256_castsi256_ps(c)) << 16)
+                | ((uint32_t)_mm256_movemask_ps(_mm256_castsi256_ps(d)) << 24);
+        return i + __builtin_ctz(mask);
+    }
+    return -1;
+}
+#endif
+
+/*
+ * Picks the search to use. A kind the CPU does not support falls back to the
+ * next narrower one.
+ */
+static int chooseKind(int kind) {
+#ifdef TLB_X86
+    __builtin_cpu_init();
+    if((kind == TLB_AUTO || kind == TLB_AVX2) && __builtin_cpu_supports("avx2"))
+        return TLB_AVX2;
+    if(kind != TLB_SCALAR && __builtin_cpu_supports("sse2"))
+        return TLB_SSE2;
+#else
+    (void)kind;
+#endif
+    return TLB_SCALAR;
+}
+
+TLB *newTLB(int size, int kind) {
+    TLB *t = malloc(sizeof(TLB));
+    assert(t != 0);
+
+    int capacity = (size + TLB_LANES - 1) / TLB_LANES * TLB_LANES;
+    t->tags = malloc(sizeof(int32_t) * capacity);
+    assert(t->tags != 0);
+    for(int i=0; i<capacity; i++)
+        t->tags[i] = -1;
+    t->frames = calloc(capacity, sizeof(int));
+    assert(t->frames != 0);
+    t->size = size;
+    t->count = 0;
+    t->oldest = 0;
+    t->padded = 0;
+    t->kind = chooseKind(kind);
+    t->search = &searchScalar;
+#ifdef TLB_X86
+    if(t->kind == TLB_AVX2)
+        t->search = &searchAVX2;
+    else if(t->kind == TLB_SSE2)
+        t->search = &searchSSE2;
+#endif
+    return t;
+}
+/*
+ * Searches for the given tag in the TLB. If a match is found, the frame
+ * number is returned. If no match is found, -1 is returned.
+ */
+int findTLB(TLB *t, int32_t tag) {
+    int index = t->search(t->tags, t->padded, tag);
+    return index == -1 ? -1 : t->frames[index];
+}
+/*
+ * Adds an entry to the TLB. Uses FIFO replacement, so the oldest entry will be replaced
+ * if the table is full.
+ * Returns the tag of the entry replaced, or -1 if there was none.
+ */
+int32_t addTLB(TLB *t, int32_t tag, int frameNum) {
+    int index;
+    int32_t replaced = -1;
+    if(t->count >= t->size) {
+        if(t->oldest >= t->size)
+            t->oldest = 0;
+        index = t->oldest++;
+        replaced = t->tags[index];
+    } else {
+        index = t->count++;
+        t->padded = (t->count + TLB_LANES - 1) / TLB_LANES * TLB_LANES;
+    }
+    t->tags[index] = tag;
+    t->frames[index] = frameNum;
+    return replaced;
+}
+/*
+ * Points every entry for the given tag at a new frame. A frame number of -1
+ * invalidates the entries; they keep their slots until the FIFO replaces them.
+ * Returns the number of entries changed.
+ */
+int setTLB(TLB *t, int32_t tag, int frameNum) {
+    int changed = 0;
+    for(int i=0; i<t->count; i++) {
+        if(t->tags[i] == tag) {
+            if(frameNum == -1)
+                t->tags[i] = -1;
+            else
+                t->frames[i] = frameNum;
+            changed++;
+        }
+    }
+    return changed;
+}
+int countTLB(TLB *t) {
+    return t->count;
+}
+void getTLB(TLB *t, int index, int32_t *tag, int *frameNum) {
+    *tag = t->tags[index];
+    *frameNum = t->frames[index];
+}
+int oldestTLB(TLB *t) {
+    return t->oldest;
+}
+void setOldestTLB(TLB *t, int oldest) {
+    t->oldest = oldest;
+}
+/*
+ * The tag and frame arrays themselves, for a caller that searches a TLB of a
+ * size it knows at compile time. They never move, and every slot up to the
+ * size(and beyond, to the padding) exists; slots not in use have tag -1.
+ */
+const int32_t *tagsTLB(TLB *t) {
+    return t->tags;
+}
+const int *framesTLB(TLB *t) {
+    return t->frames;
+}
+int kindTLB(TLB *t) {
+    return t->kind;
+}
+const char *nameTLB(int kind) {
+    switch(kind) {
+    case TLB_SCALAR:
+        return "scalar";
+    case TLB_SSE2:
+        return "sse2";
+    case TLB_AVX2:
+        return "avx2";
+    default:
+        return "auto";
+    }
+}
+void freeTLB(TLB *t) {
+    free(t->tags);
+    free(t->frames);
+    free(t);
+}
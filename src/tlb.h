@@ -0,0 +1,34 @@
+#ifndef TLB_H
+#define TLB_H
+
+#include <stdint.h>
+
+/*
+ * A fully associative TLB with FIFO replacement. Tags and frame numbers are
+ * kept in separate arrays(structure of arrays) so a lookup can compare the
+ * tag against every entry with SSE2 or AVX2, 4 or 8 entries per instruction.
+ * The widest search the CPU supports is picked at runtime unless a kind is
+ * forced. Tags are non-negative; -1 marks an invalid entry.
+ */
+typedef struct tlb TLB;
+
+#define TLB_AUTO 0
+#define TLB_SCALAR 1
+#define TLB_SSE2 2
+#define TLB_AVX2 3
+
+extern TLB *newTLB(int size, int kind);
+extern int findTLB(TLB *t, int32_t tag);
+extern int32_t addTLB(TLB *t, int32_t tag, int frameNum);
+extern int setTLB(TLB *t, int32_t tag, int frameNum);
+extern int countTLB(TLB *t);
+extern void getTLB(TLB *t, int index, int32_t *tag, int *frameNum);
+extern int oldestTLB(TLB *t);
+extern void setOldestTLB(TLB *t, int oldest);
+extern const int32_t *tagsTLB(TLB *t);
+extern const int *framesTLB(TLB *t);
+extern int kindTLB(TLB *t);
+extern const char *nameTLB(int kind);
+extern void freeTLB(TLB *t);
+
+#endif
@@ -0,0 +1,53 @@
+#define _POSIX_C_SOURCE 200809L  //For clock_gettime
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "tlb.h"
+
+#define LOOKUPS 20000000L
+#define NUM_KEYS 4096
+
+/*
+ * Measures TLB lookups per second for a range of TLB sizes and every search
+ * kind the CPU supports. Each TLB is filled, then searched for random tags of
+ * which about 90% hit.
+ */
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char **argv) {
+    long lookups = argc > 1 ? atol(argv[1]) : LOOKUPS;
+    int sizes[] = {16, 64, 256, 512, 1024, 1536};
+    int kinds[] = {TLB_SCALAR, TLB_SSE2, TLB_AVX2};
+    int32_t *keys = malloc(sizeof(int32_t) * NUM_KEYS);
+
+    printf("%8s %8s %16s %8s\n", "entries", "search", "lookups/sec", "hit rate");
+    for(size_t s=0; s<sizeof(sizes)/sizeof(sizes[0]); s++) {
+        int size = sizes[s];
+        srand(size);
+        for(int i=0; i<NUM_KEYS; i++)   //Tags past size*10/9 miss
+            keys[i] = rand() % (size + size/9 + 1);
+        for(size_t k=0; k<sizeof(kinds)/sizeof(kinds[0]); k++) {
+            TLB *t = newTLB(size, kinds[k]);
+            if(kindTLB(t) != kinds[k]) {    //Not supported here
+                freeTLB(t);
+                continue;
+            }
+            for(int i=0; i<size; i++)
+                addTLB(t, i, i);
+
+            long hits = 0;
+            double start = now();
+            for(long i=0; i<lookups; i++)
+                hits += findTLB(t, keys[i & (NUM_KEYS-1)]) != -1;
+            double elapsed = now() - start;
+            printf("%8d %8s %16.0f %8.3f\n", size, nameTLB(kinds[k]), lookups / elapsed, (double)hits / lookups);
+            freeTLB(t);
+        }
+    }
+    free(keys);
+    return 0;
+}
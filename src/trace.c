@@ -0,0 +1,153 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "trace.h"
+#include "scanner.h"
+
+#define REF_BUFFER 100
+
+/*
+ * Parses a single trace token into ref.
+ * Returns 0 on success, or -1 if the token is malformed.
+ */
+int parseReference(const char *token, TRACE_REF *ref) {
+    char *end;
+    memset(ref, 0, sizeof(TRACE_REF));
+    long cpu = strtol(token, &end, 10);
+    if(end != token && *end == '@') {   //CPU prefix
+        if(cpu < 0)
+            return -1;
+        ref->cpu = (int)cpu;
+        token = end + 1;
+    }
+    if(strncmp(token, "fork:", 5) == 0) {
+        ref->kind = TRACE_FORK;
+        ref->asid = (int)strtol(token + 5, &end, 10);
+        if(*end != ':')
+            return -1;
+        ref->child = (int)strtol(end + 1, &end, 10);
+        return *end == '\0' && ref->asid >= 0 && ref->child >= 0 ? 0 : -1;
+    }
+
+    long first = strtol(token, &end, 10);
+    if(end == token)
+        return -1;
+    if(*end == ':') {   //Address space prefix
+        ref->asid = (int)first;
+        const char *rest = end + 1;
+        first = strtol(rest, &end, 10);
+        if(end == rest || ref->asid < 0)
+            return -1;
+    }
+    ref->vaddr = (unsigned int)first;
+    if(*end == '=') {
+        const char *rest = end + 1;
+        ref->kind = TRACE_WRITE;
+        ref->value = (signed char)strtol(rest, &end, 10);
+        if(end == rest)
+            return -1;
+    }
+    return *end == '\0' ? 0 : -1;
+}
+/*
+ * Reads the next reference of a trace from fp into ref, skipping(and
+ * reporting) malformed tokens.
+ * Returns 1 if a reference was read, or 0 at EOF.
+ */
+int nextReference(FILE *fp, TRACE_REF *ref) {
+    char *token;
+    while((token = readToken(fp)) != NULL) {
+        int rc = parseReference(token, ref);
+        if(rc != 0)
+            fprintf(stderr, "Skipping malformed trace entry \"%s\".\n", token);
+        free(token);
+        if(rc == 0)
+            return 1;
+    }
+    return 0;
+}
+/*
+ * Reads a whole trace from fp into memory. Closes the file(fp) after EOF
+ * is reached.
+ */
+TRACE *readTrace(FILE *fp) {
+    TRACE *t = malloc(sizeof(TRACE));
+    assert(t != 0);
+    long capacity = REF_BUFFER;
+    t->refs = malloc(sizeof(TRACE_REF) * capacity);
+    assert(t->refs != 0);
+    t->count = 0;
+    t->numProcesses = 1;
+    t->numCPUs = 1;
+
+    TRACE_REF ref;
+    while(nextReference(fp, &ref)) {
+        if(t->count >= capacity) {
+            capacity += capacity/2;
+            t->refs = realloc(t->refs, sizeof(TRACE_REF) * capacity);
+            assert(t->refs != 0);
+        }
+        if(ref.asid >= t->numProcesses)
+            t->numProcesses = ref.asid + 1;
+        if(ref.kind == TRACE_FORK && ref.child >= t->numProcesses)
+            t->numProcesses = ref.child + 1;
+        if(ref.cpu >= t->numCPUs)
+            t->numCPUs = ref.cpu + 1;
+        t->refs[t->count++] = ref;
+    }
+    fclose(fp);
+    return t;
+}
+void freeTrace(TRACE *t) {
+    free(t->refs);
+    free(t);
+}
+/*
+ * Reduces a trace to runs of references to the same page. Addresses wrap
+ * around virtualSize just as they do when the trace is replayed.
+ */
+TRACE_RUNS *reduceTrace(const TRACE *t, unsigned int virtualSize, unsigned int pageSize) {
+    TRACE_RUNS *r = malloc(sizeof(TRACE_RUNS));
+    assert(r != 0);
+    long capacity = REF_BUFFER;
+    r->runs = malloc(sizeof(TRACE_RUN) * capacity);
+    assert(r->runs != 0);
+    r->count = 0;
+    r->offsets = malloc(sizeof(unsigned int) * (t->count > 0 ? t->count : 1));
+    assert(r->offsets != 0);
+    r->numRefs = t->count;
+
+    TRACE_RUN *last = NULL;
+    for(long i=0; i<t->count; i++) {
+        const TRACE_REF *ref = &t->refs[i];
+        unsigned int vaddr = ref->vaddr % virtualSize;
+        unsigned int page = vaddr / pageSize;
+        r->offsets[i] = vaddr % pageSize;
+        if(last != NULL && ref->kind == TRACE_READ && last->kind == TRACE_READ
+                && last->page == page && last->asid == ref->asid && last->cpu == ref->cpu) {
+            last->count++;
+            continue;
+        }
+        if(r->count >= capacity) {
+            capacity += capacity/2;
+            r->runs = realloc(r->runs, sizeof(TRACE_RUN) * capacity);
+            assert(r->runs != 0);
+        }
+        last = &r->runs[r->count++];
+        last->kind = ref->kind;
+        last->cpu = ref->cpu;
+        last->asid = ref->asid;
+        last->child = ref->child;
+        last->page = page;
+        last->value = ref->value;
+        last->count = 1;
+        last->first = i;
+    }
+    return r;
+}
+void freeTraceRuns(TRACE_RUNS *r) {
+    free(r->runs);
+    free(r->offsets);
+    free(r);
+}
@@ -0,0 +1,62 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdio.h>
+
+/*
+ * A trace is a list of whitespace(or comma) separated tokens:
+ *   address                 read by process 0
+ *   asid:address            read by process asid
+ *   [asid:]address=value    write of value(a byte)
+ *   fork:parent:child       the child's address space becomes a copy of the parent's
+ * Any of these may be prefixed with "cpu@" to make it on that CPU(0 if not).
+ */
+#define TRACE_READ 0
+#define TRACE_WRITE 1
+#define TRACE_FORK 2
+
+typedef struct trace_ref {
+    int kind;               //TRACE_READ, TRACE_WRITE or TRACE_FORK
+    int cpu;                //CPU making the reference
+    int asid;               //Process making the reference(the parent of a fork)
+    int child;              //Process created by a fork
+    unsigned int vaddr;
+    signed char value;      //Byte stored by a write
+} TRACE_REF;
+
+typedef struct trace {
+    TRACE_REF *refs;
+    long count;
+    int numProcesses;       //One more than the highest process mentioned
+    int numCPUs;            //One more than the highest CPU mentioned
+} TRACE;
+
+/*
+ * A trace reduced to runs: every read of the same page by the same process
+ * and CPU directly after another becomes part of one run. Writes and forks
+ * are runs of their own. The offset of every read within its page is kept,
+ * so the full trace can be rebuilt from the runs.
+ */
+typedef struct trace_run {
+    int kind, cpu, asid, child;
+    unsigned int page;
+    signed char value;      //Byte stored by a write
+    long count;             //References in the run
+    long first;             //Index of the run's first offset in offsets
+} TRACE_RUN;
+
+typedef struct trace_runs {
+    TRACE_RUN *runs;
+    long count;
+    unsigned int *offsets;  //Offset within its page of every reference
+    long numRefs;
+} TRACE_RUNS;
+
+extern int parseReference(const char *token, TRACE_REF *ref);
+extern int nextReference(FILE *fp, TRACE_REF *ref);
+extern TRACE *readTrace(FILE *fp);
+extern void freeTrace(TRACE *t);
+extern TRACE_RUNS *reduceTrace(const TRACE *t, unsigned int virtualSize, unsigned int pageSize);
+extern void freeTraceRuns(TRACE_RUNS *r);
+
+#endif
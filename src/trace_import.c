@@ -0,0 +1,107 @@
+#define _POSIX_C_SOURCE 200809L  //For getopt and clock_gettime
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include "import.h"
+
+#define DEFAULT_MAX_PROCESSES 64
+#define OUTPUT_BUFFER (1 << 16)
+
+static char *appendNumber(char *out, unsigned long value);
+static double now(void);
+
+/*
+ * Converts a trace recorded by another tool(see import.h) into the
+ * simulator's input format on stdout, one reference per line, so it can be
+ * piped straight into lru. A summary goes to stderr.
+ */
+int main(int argc, char **argv) {
+    int format = IMPORT_LACKEY, maxProcesses = DEFAULT_MAX_PROCESSES, flags = 0;
+    int opt;
+    while((opt = getopt(argc, argv, "f:n:Ic")) != -1) {
+        switch(opt) {
+        case 'f':   //Format of the input
+            format = formatImport(optarg);
+            if(format < 0)
+                argc = -1;
+            break;
+        case 'n':   //Most processes to keep
+            maxProcesses = atoi(optarg);
+            break;
+        case 'I':   //Keep Lackey's instruction fetches
+            flags |= IMPORT_INSTRUCTIONS;
+            break;
+        case 'c':   //Keep the CPU of perf samples
+            flags |= IMPORT_CPUS;
+            break;
+        default:
+            argc = -1;  //Forces the usage message below
+        }
+    }
+    if(argc - optind > 1 || argc < 0) {
+        fprintf(stderr, "Incorrect usage of parameters. Correct usage: %s [-f lackey|perf|csv] [-n max_processes] [-I] [-c] [inputfile|-]\n", argv[0]);
+        return -1;
+    }
+    IMPORTER *im = newImporter(optind < argc ? argv[optind] : "-", format, maxProcesses, flags);
+    if(im == NULL)
+        return -2;
+
+    static char buffer[OUTPUT_BUFFER];
+    char *out = buffer;
+    double start = now();
+    TRACE_REF ref;
+    while(nextImported(im, &ref)) {
+        if(out - buffer > OUTPUT_BUFFER - 64) {
+            fwrite(buffer, 1, out - buffer, stdout);
+            out = buffer;
+        }
+        if(ref.cpu != 0) {
+            out = appendNumber(out, (unsigned long)ref.cpu);
+            *out++ = '@';
+        }
+        if(ref.asid != 0) {
+            out = appendNumber(out, (unsigned long)ref.asid);
+            *out++ = ':';
+        }
+        out = appendNumber(out, ref.vaddr);
+        if(ref.kind == TRACE_WRITE) {
+            *out++ = '=';
+            if(ref.value < 0)
+                *out++ = '-';
+            out = appendNumber(out, ref.value < 0 ? -(unsigned long)ref.value : (unsigned long)ref.value);
+        }
+        *out++ = '\n';
+    }
+    fwrite(buffer, 1, out - buffer, stdout);
+    fflush(stdout);
+
+    IMPORT_STATS stats;
+    statsImport(im, &stats);
+    double elapsed = now() - start;
+    fprintf(stderr, "Lines = %ld, References = %ld, Malformed = %ld, Dropped = %ld\n",
+            stats.lines, stats.references, stats.malformed, stats.dropped);
+    fprintf(stderr, "Import Time = %f s (%f lines/sec)\n", elapsed, elapsed > 0 ? stats.lines / elapsed : -1);
+    freeImporter(im);
+    return 0;
+}
+/*
+ * Writes value in decimal at out, returning the end of it.
+ */
+static char *appendNumber(char *out, unsigned long value) {
+    char digits[24];
+    int n = 0;
+    do {
+        digits[n++] = (char)('0' + value % 10);
+        value /= 10;
+    } while(value != 0);
+    while(n > 0)
+        *out++ = digits[--n];
+    return out;
+}
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
@@ -0,0 +1,2030 @@
+#define _POSIX_C_SOURCE 200809L  //For mmap
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <assert.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#ifdef __SSE2__
+#include <emmintrin.h>  //For the vectorized zero page check
+#endif
+#include "vmm.h"
+#include "dll.h"        //For the LRU page replacement
+#include "zswap.h"      //For the compressed swap tier
+#include "snapshot.h"   //For checkpoints
+#include "tlb.h"        //For the SIMD searched TLB
+#include "eventlog.h"   //For the binary event log
+#include "swapdev.h"    //For the swap device timing model
+
+#define DEFAULT_PROGRAM_LOCATION "BACKING_STORE.bin"
+#define DEFAULT_PROGRAM_MEMORY_SIZE 65536       //Size of the "program" in bytes
+#define DEFAULT_ALLOCATED_MEMORY 65536/2        //Size of the memory allocated to the "program" in bytes
+#define DEFAULT_PAGE_SIZE 256                   //Size of each page in bytes
+#define DEFAULT_TLB_SIZE 16                     //Number of entries in the TLB
+#define DEFAULT_IPI_CYCLES 2000                 //Cost of one TLB shootdown IPI
+#define DEFAULT_NODE_LATENCY 80                 //Nanoseconds for an access to a node's own memory
+#define DEFAULT_REMOTE_LATENCY 60               //Extra nanoseconds for an access to another node's memory
+#define DEFAULT_SLOW_LATENCY 250                //Nanoseconds for an access to the slow tier
+#define DEFAULT_PROMOTE_INTERVAL 4              //References between samples for promotion
+#define DEFAULT_PROMOTE_THRESHOLD 2             //Samples that make a slow page hot
+#define DEFAULT_SWAP_STRIPE 1                   //Pages in each stripe unit of the swap devices
+#define DEFAULT_SWAP_DEPTH 32                   //Requests each swap device holds waiting
+#define DEFAULT_SWAP_LATENCY 100000             //Nanoseconds a swap device takes for a page
+#define DEFAULT_SWAP_SEEK 8000000               //Nanoseconds of a full seek on a swap device
+#define DEFAULT_SWAP_DEADLINE 5000000           //Nanoseconds a swap read may wait under the deadline scheduler
+#define SNAPSHOT_MAGIC "VMMSNAP"                //First 8 bytes of a checkpoint file
+#define PROFILE_MAGIC "VMMHEAT"                 //First 8 bytes of a binary profile
+#define PROFILE_VERSION 1
+#define SNAPSHOT_VERSION 11                     //Bumped whenever the checkpoint layout changes
+#define BATCH_PREFETCH 8                        //References ahead of the current one that a batch prefetches for
+#define BATCH_STAGE_LIMIT 4096                  //Most pages a batch reads from the backing store up front
+
+/*
+ * Logs an event if an event log is open; otherwise each site costs one
+ * well-predicted branch. Building with -DVMM_NO_EVENTS removes them all.
+ */
+#ifdef VMM_NO_EVENTS
+#define LOG_EVENT(ctx, type, page, frame, victim) do { (void)(page); (void)(frame); (void)(victim); } while(0)
+#else
+#define LOG_EVENT(ctx, type, page, frame, victim) do { \
+        if(__builtin_expect((ctx)->events != NULL, 0)) \
+            logEvent((ctx)->events, (ctx)->cpu, (ctx)->stats.pageAccesses, type, page, frame, victim); \
+    } while(0)
+#endif
+
+/*
+ * One virtual page(of one address space) that maps a frame.
+ */
+typedef struct mapping MAPPING;
+struct mapping {
+    int asid, pageNum;
+    MAPPING *next;
+};
+
+/*
+ * Contains a char array to simulate holding an array of bytes.
+ * Also holds the frame it lives in and every virtual page mapping it(its
+ * reverse map). A page with more than one mapping is shared and read-only;
+ * writing to it breaks the sharing(copy-on-write).
+ */
+typedef struct page {
+    int frameNum;
+    char *content;
+    int refs;           //Number of mappings
+    int dirty;          //Content differs from what the mappings would read back in
+    MAPPING *mappings;
+    DLL_NODE *lru;      //Where the page sits in the LRU stack
+    int lastNode;       //Node of the last AutoNUMA sample of the page, or -1
+    int heat;           //Samples of the page since it was last demoted
+} PAGE;
+static PAGE *newPAGE(int f, char *c) {
+    PAGE *p = malloc(sizeof(PAGE));
+    assert(p != 0);
+
+    p->frameNum = f;
+    p->content = c;
+    p->refs = 0;
+    p->dirty = 0;
+    p->mappings = NULL;
+    p->lru = NULL;
+    p->lastNode = -1;
+    p->heat = 0;
+    return p;
+}
+static void freePAGE(PAGE *p) {
+    MAPPING *m = p->mappings, *next;
+    while(m != NULL) {
+        next = m->next;
+        free(m);
+        m = next;
+    }
+    free(p->content);
+    free(p);
+}
+static void freePageValue(void *v) {
+    freePAGE(v);
+}
+static void displayPage(void *v, FILE *fp) {
+    PAGE *p = v;
+    if(p && p->mappings)
+        fprintf(fp, "PageNum: %d", p->mappings->pageNum);
+    else
+        fprintf(fp, "NULL PAGE");
+}
+static void addMapping(PAGE *p, int asid, int pageNum) {
+    MAPPING *m = malloc(sizeof(MAPPING));
+    assert(m != 0);
+
+    m->asid = asid;
+    m->pageNum = pageNum;
+    m->next = p->mappings;
+    p->mappings = m;
+    p->refs++;
+}
+static void removeMapping(PAGE *p, int asid, int pageNum) {
+    MAPPING **link = &p->mappings;
+    while(*link != NULL) {
+        MAPPING *m = *link;
+        if(m->asid == asid && m->pageNum == pageNum) {
+            *link = m->next;
+            free(m);
+            p->refs--;
+            return;
+        }
+        link = &m->next;
+    }
+    fprintf(stderr, "Error in removeMapping; page %d of process %d does not map frame %d.\n", pageNum, asid, p->frameNum);
+}
+
+/*
+ * Holds the mappings from pages to frames of one address space.
+ * page_to_frame has indexes that relate to the page numbers. The integer stored
+ * at that index relates to its frame number. If the number is -1, then that
+ * page is not currently in memory.
+ */
+typedef struct page_table {
+    int *page_to_frame;
+    int numPages;
+} PAGE_TABLE;
+static PAGE_TABLE *newPAGE_TABLE(int numP) {
+    PAGE_TABLE *p = malloc(sizeof(PAGE_TABLE));
+    assert(p != 0);
+
+    p->page_to_frame = malloc(sizeof(int) * numP);
+    assert(p->page_to_frame != 0);
+    for(int i=0; i<numP; i++) {
+        p->page_to_frame[i] = -1;   //Initialize each value to the unmapped value -1
+    }
+
+    p->numPages = numP;
+    return p;
+}
+static void freePAGE_TABLE(PAGE_TABLE *p) {
+    free(p->page_to_frame);
+    free(p);
+}
+static int getFrameNumber(PAGE_TABLE *table, int pageNum) {
+    return table->page_to_frame[pageNum];
+}
+static void addPageTableEntry(PAGE_TABLE *table, int pageNum, int frameNum) {
+    table->page_to_frame[pageNum] = frameNum;
+}
+static void removePageTableEntry(PAGE_TABLE *table, int pageNum) {
+    if(table->page_to_frame[pageNum] == -1)
+        fprintf(stderr, "Error, attempting to remove an entry with page number %d.\n", pageNum);
+    table->page_to_frame[pageNum] = -1;
+}
+
+/*
+ * Counters of one virtual page. lastAccess is the value of
+ * stats.pageAccesses at its latest access, or 0 if it has not been accessed.
+ */
+typedef struct page_profile {
+    long accesses, faults, evictions;
+    long lastAccess;
+} PAGE_PROFILE;
+
+/*
+ * A loop that vmm_translate_batch runs over addresses already checked to be
+ * in range.
+ */
+typedef void (*BATCH_LOOP)(VMM_CTX *ctx, const unsigned int *vaddrs, size_t count,
+        unsigned int *paddrs, signed char *values);
+
+/*
+ * All of the state belonging to one simulator instance. Everything that used
+ * to be a file-scope global lives here.
+ */
+struct vmm_ctx {
+    VMM_CONFIG config;
+    char *storePath;            //Private copy of config.backingStore
+    int numPages, numFrames, freeFrames;
+    int nodeStart[VMM_MAX_NODES+2];     //First frame of each node, then of the slow tier(and one past it)
+    int nodeFree[VMM_MAX_NODES+1];      //Free frames of each node, then of the slow tier
+    int slowNode;                       //Index of the slow tier among the nodes(numNodes)
+    unsigned int offsetBits, offsetMask;
+    FILE *store;                //The "program" on disk(backing store)
+    PAGE **frames;              //Stores the pages in "memory"(frames)
+    TLB **tlbs;                 //Each CPU's cache of frames by virtual page(asid * numPages + page)
+    int cpu;                    //CPU making the current reference
+    VMM_CPU_STATS *cpuStats;
+    PAGE_PROFILE *profile;      //Counters of every virtual page, or NULL if not profiling
+    long reuse[VMM_REUSE_BUCKETS];  //Reuse distance histogram
+    long coldAccesses;          //First accesses, which have no reuse distance
+    PAGE_TABLE **pageTables;    //Stores the mappings of every address space
+    char **swap;                //Written-back content of each virtual page, or NULL
+    DLL *pageStack;             //Stores all pages in order of usage(0 - recent, maxSize - least)
+    DLL *slowStack;             //Same, for the pages in the slow tier
+    ZSWAP *zswap;               //Compressed copies of evicted pages, or NULL
+    SWAP_DEVICES *swapDevices;  //Timing model of the swap space, or NULL
+    PAGE *zeroPage;             //Shared read-only page of zeros, in the frame just past the real ones
+    long sinceDedup;            //References since the last deduplication pass
+    int *stagedSlot;            //Slot in staged holding each page of the backing store, or -1
+    int *stagedPages;           //Pages currently staged, in page order
+    int numStaged;
+    char *staged;               //Backing store pages read ahead by a batch
+    BATCH_LOOP batchLoop;       //Loop of vmm_translate_batch, specialized for the geometry or generic
+    const char *batchName;
+    EVENT_LOG *events;          //Where events are logged, or NULL
+    int victim;                 //Page(across every address space) whose frame the last fault took, or -1
+    VMM_STATS stats;            //Various statistics
+};
+
+static int checkAccess(VMM_CTX *ctx, int asid, unsigned int vaddr);
+static int translateAddress(VMM_CTX *ctx, int asid, int pageNum);
+static int lookupTLB(VMM_CTX *ctx, int asid, int pageNum);
+static int lookupPageTable(VMM_CTX *ctx, int asid, int pageNum);
+static int loadPage(VMM_CTX *ctx, int asid, int pageNum);
+static int copyOnWrite(VMM_CTX *ctx, int asid, int pageNum, PAGE *shared);
+static int installPage(VMM_CTX *ctx, int asid, int pageNum, char *data);
+static int allocateFrame(VMM_CTX *ctx, int node);
+static int freeFrameOnNode(VMM_CTX *ctx, int node);
+static void placeFrame(VMM_CTX *ctx, int frameNum, PAGE *p);
+static void clearFrame(VMM_CTX *ctx, int frameNum);
+static int nodeOfFrame(VMM_CTX *ctx, int frameNum);
+static int homeNode(VMM_CTX *ctx, int asid);
+static int placementNode(VMM_CTX *ctx, int asid, int pageNum);
+static void accountAccess(VMM_CTX *ctx, int frameNum, int home, long count);
+static void sampleNUMA(VMM_CTX *ctx, PAGE *p, int home);
+static void migratePage(VMM_CTX *ctx, PAGE *p, int node);
+static void samplePromotion(VMM_CTX *ctx, PAGE *p, int home);
+static void demotePage(VMM_CTX *ctx, PAGE *p);
+static void movePage(VMM_CTX *ctx, PAGE *p, int frameNum);
+static void remapPage(VMM_CTX *ctx, PAGE *p, int frameNum);
+static void evictPage(VMM_CTX *ctx, PAGE *p);
+static void releasePage(VMM_CTX *ctx, PAGE *p);
+static void writeSwap(void *arg, int vpn, const char *content);
+static void readBackingStore(VMM_CTX *ctx, int pageNum, char *data);
+static void accessSwap(VMM_CTX *ctx, int vpn, int write);
+static void stageFaults(VMM_CTX *ctx, const unsigned int *vaddrs, size_t count);
+static void unstageFaults(VMM_CTX *ctx);
+static void chooseBatchLoop(VMM_CTX *ctx);
+static void batchGeneric(VMM_CTX *ctx, const unsigned int *vaddrs, size_t count,
+        unsigned int *paddrs, signed char *values);
+static void prefetchPageTable(VMM_CTX *ctx, unsigned int vaddr);
+static void prefetchPage(VMM_CTX *ctx, unsigned int vaddr);
+static int isZeroPage(const char *data, unsigned int size);
+static PAGE *getPage(VMM_CTX *ctx, int frameNum);
+static void mapPage(VMM_CTX *ctx, PAGE *p, int asid, int pageNum);
+static void unmapPage(VMM_CTX *ctx, PAGE *p, int asid, int pageNum);
+static PAGE *touchFrame(VMM_CTX *ctx, int frameNum);
+static int firstMapping(VMM_CTX *ctx, PAGE *p);
+static void profileAccess(VMM_CTX *ctx, int vpn);
+
+static DLL *stackOf(VMM_CTX *ctx, PAGE *p);
+static void pushPageLRU(VMM_CTX *ctx, PAGE *p);
+static void updatePageLRU(VMM_CTX *ctx, PAGE *p);
+static PAGE *popPageLRU(DLL *stack);
+static void removePageLRU(VMM_CTX *ctx, PAGE *p);
+
+static void addTLBEntry(VMM_CTX *ctx, int asid, int pageNum, int frameNum);
+static int findTLBEntry(VMM_CTX *ctx, int asid, int pageNum);
+static void setTLBEntry(VMM_CTX *ctx, int asid, int pageNum, int frameNum);
+
+/*
+ * Fills in the geometry the original assignment was built around.
+ */
+void vmm_default_config(VMM_CONFIG *config) {
+    config->backingStore = DEFAULT_PROGRAM_LOCATION;
+    config->pageSize = DEFAULT_PAGE_SIZE;
+    config->virtualSize = DEFAULT_PROGRAM_MEMORY_SIZE;
+    config->physicalSize = DEFAULT_ALLOCATED_MEMORY;
+    config->tlbSize = DEFAULT_TLB_SIZE;
+    config->tlbSearch = TLB_AUTO;
+    config->numProcesses = 1;
+    config->zswapSize = 0;
+    config->dedupInterval = 0;
+    config->zeroPages = 0;
+    config->numCPUs = 1;
+    config->ipiCycles = DEFAULT_IPI_CYCLES;
+    config->profilePages = 1;
+    config->numNodes = 1;
+    for(int i=0; i<VMM_MAX_NODES; i++) {
+        config->nodeSize[i] = 0;
+        config->nodeLatency[i] = DEFAULT_NODE_LATENCY;
+    }
+    config->remoteLatency = DEFAULT_REMOTE_LATENCY;
+    config->numaPolicy = VMM_NUMA_FIRST_TOUCH;
+    config->preferredNode = 0;
+    config->numaScanInterval = 0;
+    config->slowSize = 0;
+    config->slowLatency = DEFAULT_SLOW_LATENCY;
+    config->promoteInterval = DEFAULT_PROMOTE_INTERVAL;
+    config->promoteThreshold = DEFAULT_PROMOTE_THRESHOLD;
+    config->swapDevices = 0;
+    config->swapStripe = DEFAULT_SWAP_STRIPE;
+    config->swapDepth = DEFAULT_SWAP_DEPTH;
+    config->swapScheduler = VMM_IO_FIFO;
+    config->swapLatency = DEFAULT_SWAP_LATENCY;
+    config->swapSeek = DEFAULT_SWAP_SEEK;
+    config->swapDeadline = DEFAULT_SWAP_DEADLINE;
+    config->specialize = 1;
+}
+/*
+ * Creates a new simulator instance from the given configuration.
+ * Returns NULL if the configuration is invalid or the backing store could
+ * not be opened.
+ */
+VMM_CTX *vmm_create(const VMM_CONFIG *config) {
+    unsigned int pageSize = config->pageSize;
+    if(pageSize == 0 || (pageSize & (pageSize-1)) != 0) {
+        fprintf(stderr, "Page size %u is not a power of two.\n", pageSize);
+        return NULL;
+    }
+    if(config->virtualSize < pageSize || config->virtualSize % pageSize != 0
+            || config->physicalSize < pageSize || config->physicalSize % pageSize != 0) {
+        fprintf(stderr, "Memory sizes must be non-zero multiples of the page size.\n");
+        return NULL;
+    }
+    if(config->tlbSize == 0) {
+        fprintf(stderr, "The TLB must have at least one entry.\n");
+        return NULL;
+    }
+    if(config->numProcesses <= 0) {
+        fprintf(stderr, "There must be at least one process.\n");
+        return NULL;
+    }
+    if(config->numCPUs <= 0) {
+        fprintf(stderr, "There must be at least one CPU.\n");
+        return NULL;
+    }
+    if(config->numNodes <= 0 || config->numNodes > VMM_MAX_NODES
+            || config->preferredNode < 0 || config->preferredNode >= config->numNodes) {
+        fprintf(stderr, "There must be 1 to %d NUMA nodes, and the preferred one must be one of them.\n", VMM_MAX_NODES);
+        return NULL;
+    }
+    if(config->slowSize % pageSize != 0 || (config->slowSize > 0 && config->promoteInterval <= 0)) {
+        fprintf(stderr, "The slow tier must be a multiple of the page size, and be sampled.\n");
+        return NULL;
+    }
+    if(config->swapDevices < 0 || (config->swapDevices > 0 && (config->swapStripe <= 0 || config->swapDepth <= 0
+            || config->swapScheduler < VMM_IO_FIFO || config->swapScheduler > VMM_IO_DEADLINE
+            || config->swapLatency < 0 || config->swapSeek < 0 || config->swapDeadline < 0))) {
+        fprintf(stderr, "Swap devices need a positive stripe and queue depth, a scheduler and non-negative times.\n");
+        return NULL;
+    }
+    unsigned int nodeTotal = 0;
+    for(int i=0; i<config->numNodes; i++) {
+        if(config->nodeSize[i] % pageSize != 0) {
+            fprintf(stderr, "NUMA node sizes must be multiples of the page size.\n");
+            return NULL;
+        }
+        nodeTotal += config->nodeSize[i];
+    }
+    if(nodeTotal != 0 && nodeTotal != config->physicalSize) {
+        fprintf(stderr, "NUMA node sizes add up to %u bytes rather than %u.\n", nodeTotal, config->physicalSize);
+        return NULL;
+    }
+
+    FILE *store = fopen(config->backingStore, "rb");
+    if(store == NULL) {
+        fprintf(stderr, "Backing store %s could not be read from.\n", config->backingStore);
+        return NULL;
+    }
+
+    VMM_CTX *ctx = malloc(sizeof(VMM_CTX));
+    assert(ctx != 0);
+
+    ctx->config = *config;
+    ctx->storePath = malloc(strlen(config->backingStore) + 1);
+    assert(ctx->storePath != 0);
+    strcpy(ctx->storePath, config->backingStore);
+    ctx->config.backingStore = ctx->storePath;
+    ctx->numPages = config->virtualSize / pageSize;
+    int fastFrames = config->physicalSize / pageSize;
+    ctx->numFrames = fastFrames + config->slowSize / pageSize;
+    ctx->freeFrames = ctx->numFrames;
+    ctx->nodeStart[0] = 0;
+    for(int i=0; i<config->numNodes; i++) {
+        int frames = nodeTotal != 0 ? (int)(config->nodeSize[i] / pageSize)
+                : fastFrames / config->numNodes + (i < fastFrames % config->numNodes);
+        ctx->nodeStart[i+1] = ctx->nodeStart[i] + frames;
+        ctx->nodeFree[i] = frames;
+    }
+    ctx->slowNode = config->numNodes;   //The slow tier follows the nodes
+    ctx->nodeStart[ctx->slowNode+1] = ctx->numFrames;
+    ctx->nodeFree[ctx->slowNode] = ctx->numFrames - fastFrames;
+    ctx->offsetBits = 0;
+    while((1u << ctx->offsetBits) < pageSize)
+        ctx->offsetBits++;
+    ctx->offsetMask = pageSize - 1;
+    ctx->store = store;
+
+    ctx->frames = calloc(ctx->numFrames, sizeof(PAGE *));
+    assert(ctx->frames != 0);
+    ctx->tlbs = malloc(sizeof(TLB *) * config->numCPUs);
+    assert(ctx->tlbs != 0);
+    for(int i=0; i<config->numCPUs; i++)
+        ctx->tlbs[i] = newTLB((int)config->tlbSize, config->tlbSearch);
+    ctx->cpu = 0;
+    ctx->cpuStats = calloc(config->numCPUs, sizeof(VMM_CPU_STATS));
+    assert(ctx->cpuStats != 0);
+    ctx->profile = NULL;
+    if(config->profilePages) {
+        ctx->profile = calloc((size_t)config->numProcesses * ctx->numPages, sizeof(PAGE_PROFILE));
+        assert(ctx->profile != 0);
+    }
+    memset(ctx->reuse, 0, sizeof(ctx->reuse));
+    ctx->coldAccesses = 0;
+    ctx->pageTables = malloc(sizeof(PAGE_TABLE *) * config->numProcesses);
+    assert(ctx->pageTables != 0);
+    for(int i=0; i<config->numProcesses; i++)
+        ctx->pageTables[i] = newPAGE_TABLE(ctx->numPages);
+    ctx->swap = calloc((size_t)config->numProcesses * ctx->numPages, sizeof(char *));
+    assert(ctx->swap != 0);
+    ctx->pageStack = newDLL(&displayPage, &freePageValue);
+    ctx->slowStack = newDLL(&displayPage, &freePageValue);
+    ctx->zswap = NULL;
+    if(config->zswapSize > 0)
+        ctx->zswap = newZSWAP(config->zswapSize, config->numProcesses * ctx->numPages, pageSize, &writeSwap, ctx);
+    ctx->swapDevices = NULL;
+    if(config->swapDevices > 0) {
+        ctx->swapDevices = newSwapDevices(config->swapDevices, (long)config->numProcesses * ctx->numPages,
+                config->swapStripe, config->swapDepth, config->swapScheduler,
+                config->swapLatency, config->swapSeek, config->swapDeadline);
+    }
+    char *zeros = calloc(pageSize, sizeof(char));
+    assert(zeros != 0);
+    ctx->zeroPage = newPAGE(ctx->numFrames, zeros);
+    ctx->sinceDedup = 0;
+    ctx->stagedSlot = malloc(sizeof(int) * ctx->numPages);
+    assert(ctx->stagedSlot != 0);
+    for(int i=0; i<ctx->numPages; i++)
+        ctx->stagedSlot[i] = -1;
+    ctx->stagedPages = malloc(sizeof(int) * ctx->numPages);
+    assert(ctx->stagedPages != 0);
+    ctx->numStaged = 0;
+    ctx->staged = NULL;
+    ctx->events = NULL;
+    ctx->victim = -1;
+    memset(&ctx->stats, 0, sizeof(VMM_STATS));
+    chooseBatchLoop(ctx);
+    return ctx;
+}
+/*
+ * Releases every resource held by the given instance.
+ */
+void vmm_destroy(VMM_CTX *ctx) {
+    if(ctx == NULL)
+        return;
+    vmm_close_event_log(ctx);
+    freeDLL(ctx->pageStack);    //Frees every resident page
+    freeDLL(ctx->slowStack);
+    freePAGE(ctx->zeroPage);
+    for(int i=0; i<ctx->config.numProcesses; i++)
+        freePAGE_TABLE(ctx->pageTables[i]);
+    free(ctx->pageTables);
+    for(int i=0; i<ctx->config.numProcesses * ctx->numPages; i++)
+        free(ctx->swap[i]);
+    free(ctx->swap);
+    if(ctx->zswap)
+        freeZSWAP(ctx->zswap);
+    if(ctx->swapDevices)
+        freeSwapDevices(ctx->swapDevices);
+    for(int i=0; i<ctx->config.numCPUs; i++)
+        freeTLB(ctx->tlbs[i]);
+    free(ctx->tlbs);
+    free(ctx->cpuStats);
+    free(ctx->profile);
+    free(ctx->stagedSlot);
+    free(ctx->stagedPages);
+    free(ctx->staged);
+    free(ctx->frames);
+    fclose(ctx->store);
+    free(ctx->storePath);
+    free(ctx);
+}
+/*
+ * Performs one memory reference to the given virtual address of process 0;
+ * the TLB, page table and replacement state are all updated as they would be
+ * for a load. The physical address is stored in paddr(if not NULL).
+ * Returns 0 on success, or -1 if the address lies outside of the "program".
+ */
+int vmm_translate(VMM_CTX *ctx, unsigned int vaddr, unsigned int *paddr) {
+    return vmm_access(ctx, 0, vaddr, 0, NULL, paddr);
+}
+/*
+ * Same as vmm_translate, but also fetches the byte stored at the physical
+ * address into value.
+ */
+int vmm_read(VMM_CTX *ctx, unsigned int vaddr, unsigned int *paddr, signed char *value) {
+    return vmm_access(ctx, 0, vaddr, 0, value, paddr);
+}
+/*
+ * Stores value at the given virtual address of the given process, breaking
+ * any sharing of its page first.
+ */
+int vmm_write(VMM_CTX *ctx, int asid, unsigned int vaddr, signed char value, unsigned int *paddr) {
+    return vmm_access(ctx, asid, vaddr, 1, &value, paddr);
+}
+/*
+ * Performs one memory reference by the given process. For a write, *value is
+ * stored at the address; for a read, the byte found there is stored in
+ * value(if not NULL). The physical address is stored in paddr(if not NULL).
+ * Returns 0 on success, or -1 if the process or address is out of range.
+ */
+int vmm_access(VMM_CTX *ctx, int asid, unsigned int vaddr, int write, signed char *value, unsigned int *paddr) {
+    return vmm_access_cpu(ctx, 0, asid, vaddr, write, value, paddr);
+}
+/*
+ * Same as vmm_access, but made by the given CPU: its own TLB is searched and
+ * filled. Unmapping or remapping a page that other CPUs' TLBs hold shoots
+ * those entries down, at the cost of one IPI per CPU.
+ * Returns -1 if the CPU is out of range as well.
+ */
+int vmm_access_cpu(VMM_CTX *ctx, int cpu, int asid, unsigned int vaddr, int write,
+        signed char *value, unsigned int *paddr) {
+    if(cpu < 0 || cpu >= ctx->config.numCPUs) {
+        fprintf(stderr, "CPU %d does not exist.\n", cpu);
+        return -1;
+    }
+    if(checkAccess(ctx, asid, vaddr) != 0)
+        return -1;
+    ctx->cpu = cpu;
+    ctx->cpuStats[cpu].references++;
+    int pageNum = (int)(vaddr >> ctx->offsetBits);
+    unsigned int offset = vaddr & ctx->offsetMask;
+    int frame = translateAddress(ctx, asid, pageNum);
+    if(ctx->profile)
+        profileAccess(ctx, asid * ctx->numPages + pageNum);
+    PAGE *page = touchFrame(ctx, frame);
+    if(write && page != NULL) {
+        if(page->refs > 1 || page == ctx->zeroPage) {
+            frame = copyOnWrite(ctx, asid, pageNum, page);
+            page = getPage(ctx, frame);
+        }
+        page->content[offset] = *value;
+        page->dirty = 1;
+    } else if(value) {
+        *value = page != NULL ? page->content[offset] : 0;
+    }
+    if(paddr)
+        *paddr = ((unsigned int)frame << ctx->offsetBits) | offset;
+
+    int home = homeNode(ctx, asid);
+    accountAccess(ctx, frame, home, 1);
+    if(ctx->config.numaScanInterval > 0 && ctx->stats.pageAccesses % ctx->config.numaScanInterval == 0
+            && page != NULL && page != ctx->zeroPage)
+        sampleNUMA(ctx, page, home);
+    if(ctx->config.slowSize > 0 && ctx->stats.pageAccesses % ctx->config.promoteInterval == 0
+            && page != NULL && page != ctx->zeroPage)
+        samplePromotion(ctx, page, home);
+    if(ctx->config.dedupInterval > 0 && ++ctx->sinceDedup >= ctx->config.dedupInterval) {
+        vmm_dedup(ctx);
+        ctx->sinceDedup = 0;
+    }
+    return 0;
+}
+/*
+ * Makes count reads, by the given process on the given CPU, of one page in a
+ * row; the same as count calls to vmm_access_cpu at the page's offsets(or at
+ * its start, if offsets is NULL). Only the first read goes through the TLB,
+ * page table and replacement. That leaves the page in the CPU's TLB and at
+ * the front of the LRU stack, so the rest can only be TLB hits that change
+ * nothing but the counters. Physical addresses are stored in paddrs and the
+ * bytes read in values(either may be NULL).
+ * Returns 0 on success, or -1 if the CPU, process or page is out of range.
+ */
+int vmm_read_run(VMM_CTX *ctx, int cpu, int asid, unsigned int page, const unsigned int *offsets,
+        long count, unsigned int *paddrs, signed char *values) {
+    if(count <= 0)
+        return 0;
+    if(page >= (unsigned int)ctx->numPages) {
+        fprintf(stderr, "Page %u is outside of the program.\n", page);
+        return -1;
+    }
+    unsigned int base = page << ctx->offsetBits, paddr;
+    signed char value;
+    if(vmm_access_cpu(ctx, cpu, asid, base + (offsets ? offsets[0] : 0), 0, &value, &paddr) != 0)
+        return -1;
+    if(paddrs)
+        paddrs[0] = paddr;
+    if(values)
+        values[0] = value;
+
+    if(ctx->config.dedupInterval > 0 || ctx->config.numaScanInterval > 0 || ctx->config.slowSize > 0) {
+        //The page may move part way through
+        for(long i=1; i<count; i++) {
+            vmm_access_cpu(ctx, cpu, asid, base + (offsets ? offsets[i] : 0), 0,
+                    values ? &values[i] : NULL, paddrs ? &paddrs[i] : NULL);
+        }
+        return 0;
+    }
+    PAGE *p = getPage(ctx, (int)(paddr >> ctx->offsetBits));
+    unsigned int frameBase = paddr & ~ctx->offsetMask;
+    if(paddrs || values) {
+        for(long i=1; i<count; i++) {
+            unsigned int offset = offsets ? offsets[i] : 0;
+            if(paddrs)
+                paddrs[i] = frameBase | offset;
+            if(values)
+                values[i] = p != NULL ? p->content[offset] : 0;
+        }
+    }
+    long rest = count - 1;
+    accountAccess(ctx, (int)(paddr >> ctx->offsetBits), homeNode(ctx, asid), rest);
+    ctx->stats.pageAccesses += rest;
+    ctx->stats.tlbLookups += rest;
+    ctx->stats.tlbHits += rest;
+    ctx->cpuStats[cpu].references += rest;
+    ctx->cpuStats[cpu].tlbLookups += rest;
+    ctx->cpuStats[cpu].tlbHits += rest;
+    if(ctx->profile) {  //Each of the rest is reused 1 reference later
+        PAGE_PROFILE *prof = &ctx->profile[asid * ctx->numPages + (int)page];
+        prof->accesses += rest;
+        prof->lastAccess = ctx->stats.pageAccesses;
+        ctx->reuse[0] += rest;
+    }
+    return 0;
+}
+/*
+ * References count virtual addresses of process 0 in order, exactly as that
+ * many calls to vmm_read would(the same physical addresses, values, LRU order
+ * and statistics), but faster. The references are made in three stages: the
+ * pages that will fault are picked out from the page table first, then read
+ * from the backing store together in one pass in page order, and then every
+ * reference is made in turn while the page table entries and pages of those
+ * a few ahead of it are prefetched. Where the geometry has a loop compiled
+ * for it(see batch_loop.h) that loop makes the references, and otherwise the
+ * generic one. Physical addresses are stored in paddrs, and the bytes read in
+ * values(if not NULL).
+ * Returns the number of addresses translated, which is less than count only
+ * if an address was out of range.
+ */
+size_t vmm_translate_batch(VMM_CTX *ctx, const unsigned int *vaddrs, size_t count,
+        unsigned int *paddrs, signed char *values) {
+    size_t valid = 0;
+    while(valid < count && vaddrs[valid] < ctx->config.virtualSize)
+        valid++;
+
+    stageFaults(ctx, vaddrs, valid);
+    ctx->batchLoop(ctx, vaddrs, valid, paddrs, values);
+    unstageFaults(ctx);
+
+    if(valid < count)   //Reports the bad address
+        vmm_read(ctx, vaddrs[valid], &paddrs[valid], values ? &values[valid] : NULL);
+    return valid;
+}
+static void batchGeneric(VMM_CTX *ctx, const unsigned int *vaddrs, size_t count,
+        unsigned int *paddrs, signed char *values) {
+    for(size_t i=0; i<count; i++) {
+        if(i + 2*BATCH_PREFETCH < count)
+            prefetchPageTable(ctx, vaddrs[i + 2*BATCH_PREFETCH]);
+        if(i + BATCH_PREFETCH < count)
+            prefetchPage(ctx, vaddrs[i + BATCH_PREFETCH]);
+        vmm_access(ctx, 0, vaddrs[i], 0, values ? &values[i] : NULL, &paddrs[i]);
+    }
+}
+
+#define BATCH_NAME batch256x16
+#define BATCH_PAGE_BITS 8
+#define BATCH_TLB_SIZE 16
+#define BATCH_PROFILE 1
+#include "batch_loop.h"
+#define BATCH_NAME batch256x16NoProfile
+#define BATCH_PAGE_BITS 8
+#define BATCH_TLB_SIZE 16
+#define BATCH_PROFILE 0
+#include "batch_loop.h"
+#define BATCH_NAME batch256x64
+#define BATCH_PAGE_BITS 8
+#define BATCH_TLB_SIZE 64
+#define BATCH_PROFILE 1
+#include "batch_loop.h"
+#define BATCH_NAME batch256x64NoProfile
+#define BATCH_PAGE_BITS 8
+#define BATCH_TLB_SIZE 64
+#define BATCH_PROFILE 0
+#include "batch_loop.h"
+#define BATCH_NAME batch4096x16
+#define BATCH_PAGE_BITS 12
+#define BATCH_TLB_SIZE 16
+#define BATCH_PROFILE 1
+#include "batch_loop.h"
+#define BATCH_NAME batch4096x16NoProfile
+#define BATCH_PAGE_BITS 12
+#define BATCH_TLB_SIZE 16
+#define BATCH_PROFILE 0
+#include "batch_loop.h"
+#define BATCH_NAME batch4096x64
+#define BATCH_PAGE_BITS 12
+#define BATCH_TLB_SIZE 64
+#define BATCH_PROFILE 1
+#include "batch_loop.h"
+#define BATCH_NAME batch4096x64NoProfile
+#define BATCH_PAGE_BITS 12
+#define BATCH_TLB_SIZE 64
+#define BATCH_PROFILE 0
+#include "batch_loop.h"
+
+/*
+ * The specialized batch loops, by page size, TLB size and whether the
+ * instance keeps a page profile.
+ */
+typedef struct batch_variant {
+    unsigned int pageSize, tlbSize;
+    int profile;
+    const char *name;
+    BATCH_LOOP loop;
+} BATCH_VARIANT;
+static const BATCH_VARIANT BATCH_VARIANTS[] = {
+    {256, 16, 1, "256x16", &batch256x16},
+    {256, 16, 0, "256x16 unprofiled", &batch256x16NoProfile},
+    {256, 64, 1, "256x64", &batch256x64},
+    {256, 64, 0, "256x64 unprofiled", &batch256x64NoProfile},
+    {4096, 16, 1, "4096x16", &batch4096x16},
+    {4096, 16, 0, "4096x16 unprofiled", &batch4096x16NoProfile},
+    {4096, 64, 1, "4096x64", &batch4096x64},
+    {4096, 64, 0, "4096x64 unprofiled", &batch4096x64NoProfile},
+};
+/*
+ * Picks the loop vmm_translate_batch runs: the variant compiled for the
+ * instance's geometry if there is one, and otherwise the generic loop. The
+ * variants only make TLB hits themselves, so an instance that samples or
+ * deduplicates on every reference always gets the generic loop.
+ */
+static void chooseBatchLoop(VMM_CTX *ctx) {
+    const VMM_CONFIG *config = &ctx->config;
+    ctx->batchLoop = &batchGeneric;
+    ctx->batchName = "generic";
+    if(!config->specialize || config->dedupInterval > 0 || config->numaScanInterval > 0 || config->slowSize > 0)
+        return;
+    for(size_t i=0; i<sizeof(BATCH_VARIANTS)/sizeof(BATCH_VARIANTS[0]); i++) {
+        const BATCH_VARIANT *v = &BATCH_VARIANTS[i];
+        if(v->pageSize == config->pageSize && v->tlbSize == config->tlbSize && v->profile == (ctx->profile != NULL)) {
+            ctx->batchLoop = v->loop;
+            ctx->batchName = v->name;
+            return;
+        }
+    }
+}
+/*
+ * Simulates a fork: the child's address space is replaced by a copy of the
+ * parent's. Resident pages are shared(copy-on-write) rather than copied.
+ * Returns 0 on success, or -1 if either process is out of range.
+ */
+int vmm_fork(VMM_CTX *ctx, int parent, int child) {
+    return vmm_fork_cpu(ctx, 0, parent, child);
+}
+/*
+ * Same as vmm_fork, but made by the given CPU, which the shootdowns of the
+ * child's old mappings are charged to.
+ * Returns -1 if the CPU is out of range as well.
+ */
+int vmm_fork_cpu(VMM_CTX *ctx, int cpu, int parent, int child) {
+    if(cpu < 0 || cpu >= ctx->config.numCPUs) {
+        fprintf(stderr, "CPU %d does not exist.\n", cpu);
+        return -1;
+    }
+    int numProcesses = ctx->config.numProcesses;
+    if(parent < 0 || parent >= numProcesses || child < 0 || child >= numProcesses || parent == child) {
+        fprintf(stderr, "Cannot fork process %d into process %d.\n", parent, child);
+        return -1;
+    }
+    ctx->cpu = cpu;
+    PAGE_TABLE *from = ctx->pageTables[parent], *to = ctx->pageTables[child];
+    for(int i=0; i<ctx->numPages; i++) {
+        int frame = getFrameNumber(to, i);
+        if(frame != -1) {   //Tear down the child's old mapping
+            PAGE *old = getPage(ctx, frame);
+            unmapPage(ctx, old, child, i);
+            setTLBEntry(ctx, child, i, -1);
+            if(old->refs == 0 && old != ctx->zeroPage)
+                releasePage(ctx, old);
+        }
+        if(ctx->zswap)
+            invalidateZSWAP(ctx->zswap, child * ctx->numPages + i);
+
+        int parentVpn = parent * ctx->numPages + i;
+        char **childSwap = &ctx->swap[child * ctx->numPages + i];
+        char *parentSwap = ctx->swap[parentVpn];
+        free(*childSwap);
+        *childSwap = NULL;
+        if(parentSwap != NULL || ctx->zswap != NULL) {
+            *childSwap = malloc(ctx->config.pageSize);
+            assert(*childSwap != 0);
+            //A dirty copy in the pool is newer than the parent's swap copy
+            int pooled = ctx->zswap != NULL && peekDirtyZSWAP(ctx->zswap, parentVpn, *childSwap);
+            if(!pooled && parentSwap != NULL)
+                memcpy(*childSwap, parentSwap, ctx->config.pageSize);
+            else if(!pooled) {
+                free(*childSwap);
+                *childSwap = NULL;
+            }
+        }
+
+        frame = getFrameNumber(from, i);
+        if(frame != -1)
+            mapPage(ctx, getPage(ctx, frame), child, i);
+    }
+    return 0;
+}
+static uint64_t hashContent(const char *content, unsigned int size) {
+    uint64_t h = 14695981039346656037ULL;   //FNV-1a
+    for(unsigned int i=0; i<size; i++) {
+        h ^= (unsigned char)content[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+typedef struct frame_hash {
+    uint64_t hash;
+    int frameNum;
+} FRAME_HASH;
+static int compareFrameHash(const void *a, const void *b) {
+    const FRAME_HASH *x = a, *y = b;
+    if(x->hash != y->hash)
+        return x->hash < y->hash ? -1 : 1;
+    return x->frameNum - y->frameNum;
+}
+/*
+ * Runs one content-based deduplication pass: every resident frame is hashed,
+ * and frames with identical content are merged into one shared(read-only)
+ * frame. The freed frames become available for new pages.
+ * Returns the number of frames freed.
+ */
+long vmm_dedup(VMM_CTX *ctx) {
+    unsigned int pageSize = ctx->config.pageSize;
+    FRAME_HASH *hashes = malloc(sizeof(FRAME_HASH) * ctx->numFrames);
+    assert(hashes != 0);
+    int count = 0;
+    for(int i=0; i<ctx->numFrames; i++) {
+        if(ctx->frames[i] != NULL) {
+            hashes[count].hash = hashContent(ctx->frames[i]->content, pageSize);
+            hashes[count++].frameNum = i;
+        }
+    }
+    qsort(hashes, count, sizeof(FRAME_HASH), &compareFrameHash);
+
+    long merged = 0;
+    for(int start=0, end; start<count; start=end) {
+        for(end=start+1; end<count && hashes[end].hash == hashes[start].hash; end++)
+            ;
+        for(int i=start+1; i<end; i++) {
+            PAGE *dup = ctx->frames[hashes[i].frameNum];
+            for(int j=start; j<i; j++) {
+                PAGE *keep = ctx->frames[hashes[j].frameNum];
+                if(keep == NULL || memcmp(keep->content, dup->content, pageSize) != 0)
+                    continue;
+                while(dup->mappings != NULL) {  //Move every mapping over to keep
+                    int asid = dup->mappings->asid, pageNum = dup->mappings->pageNum;
+                    removeMapping(dup, asid, pageNum);
+                    addMapping(keep, asid, pageNum);
+                    addPageTableEntry(ctx->pageTables[asid], pageNum, keep->frameNum);
+                    setTLBEntry(ctx, asid, pageNum, keep->frameNum);
+                    LOG_EVENT(ctx, EVENT_MERGE, asid * ctx->numPages + pageNum, keep->frameNum, dup->frameNum);
+                }
+                keep->dirty |= dup->dirty;
+                releasePage(ctx, dup);
+                merged++;
+                break;
+            }
+        }
+    }
+    free(hashes);
+    ctx->stats.dedupMerges += merged;
+    return merged;
+}
+/*
+ * Writes the complete state of the instance(configuration, statistics, frame
+ * contents in LRU order with their mappings, page tables, TLB, swap area,
+ * compressed pool and swap devices) to a checkpoint file, tagged with the index of the next
+ * reference to be made.
+ * Returns 0 on success, or -1 if the file could not be written.
+ */
+int vmm_checkpoint(const VMM_CTX *ctx, const char *path, long refIndex) {
+    FILE *fp = fopen(path, "wb");
+    if(fp == NULL) {
+        fprintf(stderr, "Checkpoint %s could not be written to.\n", path);
+        return -1;
+    }
+    const VMM_CONFIG *config = &ctx->config;
+    writeSnapshotBytes(fp, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+    writeSnapshotI32(fp, SNAPSHOT_VERSION);
+    writeSnapshotI64(fp, refIndex);
+
+    writeSnapshotI32(fp, (int32_t)strlen(config->backingStore));
+    writeSnapshotBytes(fp, config->backingStore, strlen(config->backingStore));
+    writeSnapshotI32(fp, config->pageSize);
+    writeSnapshotI32(fp, config->virtualSize);
+    writeSnapshotI32(fp, config->physicalSize);
+    writeSnapshotI32(fp, config->tlbSize);
+    writeSnapshotI32(fp, config->tlbSearch);
+    writeSnapshotI32(fp, config->numProcesses);
+    writeSnapshotI64(fp, (int64_t)config->zswapSize);
+    writeSnapshotI64(fp, config->dedupInterval);
+    writeSnapshotI32(fp, config->zeroPages);
+    writeSnapshotI32(fp, config->numCPUs);
+    writeSnapshotI64(fp, config->ipiCycles);
+    writeSnapshotI32(fp, config->profilePages);
+    writeSnapshotI32(fp, config->numNodes);
+    for(int i=0; i<VMM_MAX_NODES; i++) {
+        writeSnapshotI32(fp, config->nodeSize[i]);
+        writeSnapshotI64(fp, config->nodeLatency[i]);
+    }
+    writeSnapshotI64(fp, config->remoteLatency);
+    writeSnapshotI32(fp, config->numaPolicy);
+    writeSnapshotI32(fp, config->preferredNode);
+    writeSnapshotI64(fp, config->numaScanInterval);
+    writeSnapshotI32(fp, config->slowSize);
+    writeSnapshotI64(fp, config->slowLatency);
+    writeSnapshotI64(fp, config->promoteInterval);
+    writeSnapshotI32(fp, config->promoteThreshold);
+    writeSnapshotI32(fp, config->swapDevices);
+    writeSnapshotI32(fp, config->swapStripe);
+    writeSnapshotI32(fp, config->swapDepth);
+    writeSnapshotI32(fp, config->swapScheduler);
+    writeSnapshotI64(fp, config->swapLatency);
+    writeSnapshotI64(fp, config->swapSeek);
+    writeSnapshotI64(fp, config->swapDeadline);
+    writeSnapshotI32(fp, config->specialize);
+
+    const long *counters = (const long *)&ctx->stats;
+    writeSnapshotI32(fp, sizeof(VMM_STATS)/sizeof(long));
+    for(size_t i=0; i<sizeof(VMM_STATS)/sizeof(long); i++)
+        writeSnapshotI64(fp, counters[i]);
+    writeSnapshotI64(fp, ctx->sinceDedup);
+
+    int fast = sizeDLL(ctx->pageStack), resident = fast + sizeDLL(ctx->slowStack);
+    writeSnapshotI32(fp, resident);
+    DLL *stack = ctx->pageStack;
+    DLL_NODE *node = NULL;
+    for(int i=0; i<resident; i++) {     //Most recently used first, the fast tier then the slow one
+        if(i == fast) {
+            stack = ctx->slowStack;
+            node = NULL;
+        }
+        node = nextNodeDLL(stack, node);
+        PAGE *p = valueNodeDLL(node);
+        writeSnapshotI32(fp, p->frameNum);
+        writeSnapshotI32(fp, p->dirty);
+        writeSnapshotI32(fp, p->refs);
+        writeSnapshotI32(fp, p->lastNode);
+        writeSnapshotI32(fp, p->heat);
+        for(MAPPING *m = p->mappings; m != NULL; m = m->next) {
+            writeSnapshotI32(fp, m->asid);
+            writeSnapshotI32(fp, m->pageNum);
+        }
+        writeSnapshotBytes(fp, p->content, config->pageSize);
+    }
+    writeSnapshotI32(fp, ctx->zeroPage->refs);
+
+    for(int a=0; a<config->numProcesses; a++) {
+        for(int i=0; i<ctx->numPages; i++)
+            writeSnapshotI32(fp, getFrameNumber(ctx->pageTables[a], i));
+    }
+
+    for(int c=0; c<config->numCPUs; c++) {
+        TLB *tlb = ctx->tlbs[c];
+        const VMM_CPU_STATS *cpuStats = &ctx->cpuStats[c];
+        writeSnapshotI64(fp, cpuStats->references);
+        writeSnapshotI64(fp, cpuStats->tlbLookups);
+        writeSnapshotI64(fp, cpuStats->tlbHits);
+        writeSnapshotI64(fp, cpuStats->ipisReceived);
+        writeSnapshotI64(fp, cpuStats->clock);
+        writeSnapshotI32(fp, countTLB(tlb));
+        writeSnapshotI32(fp, oldestTLB(tlb));
+        for(int i=0; i<countTLB(tlb); i++) {
+            int32_t tag;
+            int frameNum;
+            getTLB(tlb, i, &tag, &frameNum);
+            writeSnapshotI32(fp, tag);
+            writeSnapshotI32(fp, frameNum);
+        }
+    }
+
+    int numVpns = config->numProcesses * ctx->numPages, swapped = 0;
+    for(int i=0; i<numVpns; i++)
+        swapped += ctx->swap[i] != NULL;
+    writeSnapshotI32(fp, swapped);
+    for(int i=0; i<numVpns; i++) {
+        if(ctx->swap[i] != NULL) {
+            writeSnapshotI32(fp, i);
+            writeSnapshotBytes(fp, ctx->swap[i], config->pageSize);
+        }
+    }
+
+    if(ctx->profile) {
+        for(int i=0; i<numVpns; i++) {
+            writeSnapshotI64(fp, ctx->profile[i].accesses);
+            writeSnapshotI64(fp, ctx->profile[i].faults);
+            writeSnapshotI64(fp, ctx->profile[i].evictions);
+            writeSnapshotI64(fp, ctx->profile[i].lastAccess);
+        }
+    }
+    writeSnapshotI64(fp, ctx->coldAccesses);
+    for(int i=0; i<VMM_REUSE_BUCKETS; i++)
+        writeSnapshotI64(fp, ctx->reuse[i]);
+
+    writeSnapshotI32(fp, ctx->zswap != NULL);
+    if(ctx->zswap)
+        saveZSWAP(ctx->zswap, fp);
+    writeSnapshotI32(fp, ctx->swapDevices != NULL);
+    if(ctx->swapDevices)
+        saveSwapDevices(ctx->swapDevices, fp);
+    writeSnapshotBytes(fp, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+
+    int failed = ferror(fp);
+    if(fclose(fp) != 0 || failed) {
+        fprintf(stderr, "Checkpoint %s could not be written to.\n", path);
+        return -1;
+    }
+    return 0;
+}
+/*
+ * Rebuilds the instance state that follows the configuration in a checkpoint.
+ * Returns 0 on success, or -1 if the checkpoint is inconsistent.
+ */
+static int restoreState(VMM_CTX *ctx, SNAPSHOT_READER *r) {
+    unsigned int pageSize = ctx->config.pageSize;
+    long *counters = (long *)&ctx->stats;
+    if((size_t)readSnapshotI32(r) != sizeof(VMM_STATS)/sizeof(long))
+        return -1;
+    for(size_t i=0; i<sizeof(VMM_STATS)/sizeof(long); i++)
+        counters[i] = (long)readSnapshotI64(r);
+    ctx->sinceDedup = (long)readSnapshotI64(r);
+
+    int resident = readSnapshotI32(r);
+    if(resident < 0 || resident > ctx->numFrames)
+        return -1;
+    for(int i=0; i<resident && !r->error; i++) {
+        int frameNum = readSnapshotI32(r), dirty = readSnapshotI32(r), refs = readSnapshotI32(r);
+        int lastNode = readSnapshotI32(r), heat = readSnapshotI32(r);
+        if(frameNum < 0 || frameNum >= ctx->numFrames || ctx->frames[frameNum] != NULL
+                || lastNode < -1 || lastNode >= ctx->config.numNodes
+                || refs <= 0 || refs > ctx->config.numProcesses * ctx->numPages)
+            return -1;
+        const int32_t *pairs = readSnapshotBytes(r, sizeof(int32_t) * 2 * refs);
+        const char *content = readSnapshotBytes(r, pageSize);
+        if(pairs == NULL || content == NULL)
+            return -1;
+
+        char *data = malloc(pageSize);
+        assert(data != 0);
+        memcpy(data, content, pageSize);
+        PAGE *page = newPAGE(frameNum, data);
+        page->dirty = dirty;
+        for(int m=refs-1; m>=0; m--) {  //addMapping prepends, so this keeps the saved order
+            int32_t asid, pageNum;
+            memcpy(&asid, &pairs[2*m], sizeof(asid));
+            memcpy(&pageNum, &pairs[2*m+1], sizeof(pageNum));
+            if(asid < 0 || asid >= ctx->config.numProcesses || pageNum < 0 || pageNum >= ctx->numPages) {
+                freePAGE(page);
+                return -1;
+            }
+            addMapping(page, asid, pageNum);
+        }
+        DLL *stack = stackOf(ctx, page);
+        page->lru = insertNodeDLL(stack, sizeDLL(stack), page);
+        page->lastNode = lastNode;
+        page->heat = heat;
+        placeFrame(ctx, frameNum, page);
+    }
+    ctx->zeroPage->refs = readSnapshotI32(r);
+
+    for(int a=0; a<ctx->config.numProcesses; a++) {
+        for(int i=0; i<ctx->numPages; i++) {
+            int frame = readSnapshotI32(r);
+            if(frame < -1 || frame > ctx->numFrames || (frame >= 0 && getPage(ctx, frame) == NULL))
+                return -1;
+            if(frame != -1)
+                addPageTableEntry(ctx->pageTables[a], i, frame);
+        }
+    }
+
+    for(int c=0; c<ctx->config.numCPUs; c++) {
+        TLB *tlb = ctx->tlbs[c];
+        VMM_CPU_STATS *cpuStats = &ctx->cpuStats[c];
+        cpuStats->references = (long)readSnapshotI64(r);
+        cpuStats->tlbLookups = (long)readSnapshotI64(r);
+        cpuStats->tlbHits = (long)readSnapshotI64(r);
+        cpuStats->ipisReceived = (long)readSnapshotI64(r);
+        cpuStats->clock = (long)readSnapshotI64(r);
+        int sizeTLB = readSnapshotI32(r), oldestTLB = readSnapshotI32(r);
+        if(sizeTLB < 0 || sizeTLB > (int)ctx->config.tlbSize || oldestTLB < 0 || oldestTLB > (int)ctx->config.tlbSize)
+            return -1;
+        for(int i=0; i<sizeTLB; i++) {
+            int32_t tag = readSnapshotI32(r);
+            int frameNum = readSnapshotI32(r);
+            addTLB(tlb, tag, frameNum);
+        }
+        setOldestTLB(tlb, oldestTLB);
+    }
+
+    int numVpns = ctx->config.numProcesses * ctx->numPages;
+    int swapped = readSnapshotI32(r);
+    for(int i=0; i<swapped && !r->error; i++) {
+        int vpn = readSnapshotI32(r);
+        const char *content = readSnapshotBytes(r, pageSize);
+        if(vpn < 0 || vpn >= numVpns || content == NULL || ctx->swap[vpn] != NULL)
+            return -1;
+        ctx->swap[vpn] = malloc(pageSize);
+        assert(ctx->swap[vpn] != 0);
+        memcpy(ctx->swap[vpn], content, pageSize);
+    }
+
+    if(ctx->profile) {
+        for(int i=0; i<numVpns; i++) {
+            ctx->profile[i].accesses = (long)readSnapshotI64(r);
+            ctx->profile[i].faults = (long)readSnapshotI64(r);
+            ctx->profile[i].evictions = (long)readSnapshotI64(r);
+            ctx->profile[i].lastAccess = (long)readSnapshotI64(r);
+        }
+    }
+    ctx->coldAccesses = (long)readSnapshotI64(r);
+    for(int i=0; i<VMM_REUSE_BUCKETS; i++)
+        ctx->reuse[i] = (long)readSnapshotI64(r);
+
+    if(readSnapshotI32(r) != (ctx->zswap != NULL))
+        return -1;
+    if(ctx->zswap && restoreZSWAP(ctx->zswap, r) != 0)
+        return -1;
+    if(readSnapshotI32(r) != (ctx->swapDevices != NULL))
+        return -1;
+    if(ctx->swapDevices && restoreSwapDevices(ctx->swapDevices, r) != 0)
+        return -1;
+    const char *trailer = readSnapshotBytes(r, sizeof(SNAPSHOT_MAGIC));
+    if(trailer == NULL || memcmp(trailer, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0)
+        return -1;
+    return r->error ? -1 : 0;
+}
+/*
+ * Creates an instance from a checkpoint written by vmm_checkpoint. The file
+ * is mapped into memory rather than read. The backing store recorded in the
+ * checkpoint is used unless backingStore is not NULL. The index of the next
+ * reference to make is stored in refIndex(if not NULL).
+ * Returns NULL if the checkpoint could not be read or is not valid.
+ */
+VMM_CTX *vmm_restore(const char *path, const char *backingStore, long *refIndex) {
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    if(fd < 0 || fstat(fd, &st) != 0 || st.st_size == 0) {
+        fprintf(stderr, "Checkpoint %s could not be read from.\n", path);
+        if(fd >= 0)
+            close(fd);
+        return NULL;
+    }
+    void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(map == MAP_FAILED) {
+        fprintf(stderr, "Checkpoint %s could not be mapped.\n", path);
+        return NULL;
+    }
+
+    SNAPSHOT_READER r = {map, (const unsigned char *)map + st.st_size, 0};
+    VMM_CTX *ctx = NULL;
+    const char *magic = readSnapshotBytes(&r, sizeof(SNAPSHOT_MAGIC));
+    if(magic == NULL || memcmp(magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0) {
+        fprintf(stderr, "%s is not a checkpoint.\n", path);
+        goto done;
+    }
+    int version = readSnapshotI32(&r);
+    if(version != SNAPSHOT_VERSION) {
+        fprintf(stderr, "Checkpoint %s has version %d, expected %d.\n", path, version, SNAPSHOT_VERSION);
+        goto done;
+    }
+    long index = (long)readSnapshotI64(&r);
+
+    VMM_CONFIG config;
+    int pathLen = readSnapshotI32(&r);
+    const char *savedStore = pathLen >= 0 ? readSnapshotBytes(&r, (size_t)pathLen) : NULL;
+    config.pageSize = readSnapshotI32(&r);
+    config.virtualSize = readSnapshotI32(&r);
+    config.physicalSize = readSnapshotI32(&r);
+    config.tlbSize = readSnapshotI32(&r);
+    config.tlbSearch = readSnapshotI32(&r);
+    config.numProcesses = readSnapshotI32(&r);
+    config.zswapSize = (size_t)readSnapshotI64(&r);
+    config.dedupInterval = (long)readSnapshotI64(&r);
+    config.zeroPages = readSnapshotI32(&r);
+    config.numCPUs = readSnapshotI32(&r);
+    config.ipiCycles = (long)readSnapshotI64(&r);
+    config.profilePages = readSnapshotI32(&r);
+    config.numNodes = readSnapshotI32(&r);
+    for(int i=0; i<VMM_MAX_NODES; i++) {
+        config.nodeSize[i] = readSnapshotI32(&r);
+        config.nodeLatency[i] = (long)readSnapshotI64(&r);
+    }
+    config.remoteLatency = (long)readSnapshotI64(&r);
+    config.numaPolicy = readSnapshotI32(&r);
+    config.preferredNode = readSnapshotI32(&r);
+    config.numaScanInterval = (long)readSnapshotI64(&r);
+    config.slowSize = readSnapshotI32(&r);
+    config.slowLatency = (long)readSnapshotI64(&r);
+    config.promoteInterval = (long)readSnapshotI64(&r);
+    config.promoteThreshold = readSnapshotI32(&r);
+    config.swapDevices = readSnapshotI32(&r);
+    config.swapStripe = readSnapshotI32(&r);
+    config.swapDepth = readSnapshotI32(&r);
+    config.swapScheduler = readSnapshotI32(&r);
+    config.swapLatency = (long)readSnapshotI64(&r);
+    config.swapSeek = (long)readSnapshotI64(&r);
+    config.swapDeadline = (long)readSnapshotI64(&r);
+    config.specialize = readSnapshotI32(&r);
+    if(r.error || savedStore == NULL) {
+        fprintf(stderr, "Checkpoint %s is truncated.\n", path);
+        goto done;
+    }
+    char *store = malloc((size_t)pathLen + 1);
+    assert(store != 0);
+    memcpy(store, savedStore, (size_t)pathLen);
+    store[pathLen] = '\0';
+    config.backingStore = backingStore != NULL ? backingStore : store;
+    ctx = vmm_create(&config);
+    free(store);
+    if(ctx == NULL)
+        goto done;
+
+    if(restoreState(ctx, &r) != 0) {
+        fprintf(stderr, "Checkpoint %s is corrupt.\n", path);
+        vmm_destroy(ctx);
+        ctx = NULL;
+        goto done;
+    }
+    if(refIndex)
+        *refIndex = index;
+done:
+    munmap(map, (size_t)st.st_size);
+    return ctx;
+}
+/*
+ * Copies the configuration the instance was created with into config.
+ */
+void vmm_get_config(const VMM_CTX *ctx, VMM_CONFIG *config) {
+    *config = ctx->config;
+}
+/*
+ * Returns the name of the loop vmm_translate_batch runs: a page size and TLB
+ * size it was compiled for, or "generic".
+ */
+const char *vmm_batch_variant(const VMM_CTX *ctx) {
+    return ctx->batchName;
+}
+/*
+ * Copies the statistics gathered so far into stats.
+ */
+void vmm_get_stats(const VMM_CTX *ctx, VMM_STATS *stats) {
+    *stats = ctx->stats;
+    stats->sharedFrames = 0;
+    stats->framesSaved = 0;
+    for(int i=0; i<ctx->numFrames; i++) {
+        PAGE *p = ctx->frames[i];
+        if(p != NULL && p->refs > 1) {
+            stats->sharedFrames++;
+            stats->framesSaved += p->refs - 1;
+        }
+    }
+    stats->zeroMapped = ctx->zeroPage->refs;
+    stats->residentFrames = ctx->numFrames - ctx->freeFrames;
+    stats->elapsedTime = 0;
+    for(int c=0; c<ctx->config.numCPUs; c++) {
+        if(ctx->cpuStats[c].clock > stats->elapsedTime)
+            stats->elapsedTime = ctx->cpuStats[c].clock;
+    }
+    if(ctx->zswap) {
+        ZSWAP_STATS z;
+        statsZSWAP(ctx->zswap, &z);
+        stats->zswapStores = z.stores;
+        stats->zswapRejects = z.rejects;
+        stats->zswapHits = z.hits;
+        stats->zswapEvictions = z.evictions;
+        stats->zswapWriteBacks = z.writeBacks;
+        stats->zswapBytesIn = z.bytesIn;
+        stats->zswapBytesOut = z.bytesOut;
+    }
+}
+
+/*
+ * Copies the statistics gathered so far by one CPU into stats.
+ * Returns 0 on success, or -1 if the CPU is out of range.
+ */
+int vmm_get_cpu_stats(const VMM_CTX *ctx, int cpu, VMM_CPU_STATS *stats) {
+    if(cpu < 0 || cpu >= ctx->config.numCPUs)
+        return -1;
+    *stats = ctx->cpuStats[cpu];
+    return 0;
+}
+/*
+ * Copies the counters of one swap device into stats.
+ * Returns 0 on success, or -1 if the device is out of range or the devices
+ * are not modelled.
+ */
+int vmm_get_swap_stats(const VMM_CTX *ctx, int device, VMM_SWAP_STATS *stats) {
+    if(ctx->swapDevices == NULL || device < 0 || device >= ctx->config.swapDevices)
+        return -1;
+    statsSwapDevice(ctx->swapDevices, device, stats);
+    return 0;
+}
+
+/*
+ * Copies the counters of one virtual page into profile.
+ * Returns 0 on success, or -1 if the page is out of range or profiling is off.
+ */
+int vmm_get_page_profile(const VMM_CTX *ctx, int asid, int page, VMM_PAGE_PROFILE *profile) {
+    if(ctx->profile == NULL || asid < 0 || asid >= ctx->config.numProcesses || page < 0 || page >= ctx->numPages)
+        return -1;
+    const PAGE_PROFILE *prof = &ctx->profile[asid * ctx->numPages + page];
+    profile->accesses = prof->accesses;
+    profile->faults = prof->faults;
+    profile->evictions = prof->evictions;
+    return 0;
+}
+/*
+ * Copies the reuse distance histogram into buckets(VMM_REUSE_BUCKETS of
+ * them).
+ * Returns the number of first accesses, which are not in it.
+ */
+long vmm_get_reuse_histogram(const VMM_CTX *ctx, long *buckets) {
+    memcpy(buckets, ctx->reuse, sizeof(ctx->reuse));
+    return ctx->coldAccesses;
+}
+/*
+ * Writes the page profile to a file for plotting. A CSV profile lists every
+ * accessed page as "asid,page,accesses,faults,evictions", then after a blank
+ * line the histogram as "min_distance,max_distance,accesses"(the first row,
+ * 0,0, holds the first accesses). A binary profile holds, after its magic
+ * and version, the number of processes and pages per process, the three
+ * counters of every page as 64-bit integers, then the number of first
+ * accesses and VMM_REUSE_BUCKETS buckets.
+ * Returns 0 on success, or -1 if profiling is off or the file could not be
+ * written.
+ */
+int vmm_write_profile(const VMM_CTX *ctx, const char *path, int format) {
+    if(ctx->profile == NULL) {
+        fprintf(stderr, "Page profiling is turned off.\n");
+        return -1;
+    }
+    FILE *fp = fopen(path, format == VMM_PROFILE_BINARY ? "wb" : "w");
+    if(fp == NULL) {
+        fprintf(stderr, "Profile %s could not be written to.\n", path);
+        return -1;
+    }
+    int numVpns = ctx->config.numProcesses * ctx->numPages;
+    if(format == VMM_PROFILE_BINARY) {
+        writeSnapshotBytes(fp, PROFILE_MAGIC, sizeof(PROFILE_MAGIC));
+        writeSnapshotI32(fp, PROFILE_VERSION);
+        writeSnapshotI32(fp, ctx->config.numProcesses);
+        writeSnapshotI32(fp, ctx->numPages);
+        for(int i=0; i<numVpns; i++) {
+            writeSnapshotI64(fp, ctx->profile[i].accesses);
+            writeSnapshotI64(fp, ctx->profile[i].faults);
+            writeSnapshotI64(fp, ctx->profile[i].evictions);
+        }
+        writeSnapshotI64(fp, ctx->coldAccesses);
+        for(int i=0; i<VMM_REUSE_BUCKETS; i++)
+            writeSnapshotI64(fp, ctx->reuse[i]);
+    } else {
+        fprintf(fp, "asid,page,accesses,faults,evictions\n");
+        for(int i=0; i<numVpns; i++) {
+            const PAGE_PROFILE *prof = &ctx->profile[i];
+            if(prof->accesses > 0)
+                fprintf(fp, "%d,%d,%ld,%ld,%ld\n", i / ctx->numPages, i % ctx->numPages, prof->accesses, prof->faults, prof->evictions);
+        }
+        fprintf(fp, "\nmin_distance,max_distance,accesses\n0,0,%ld\n", ctx->coldAccesses);
+        for(int i=0; i<VMM_REUSE_BUCKETS; i++) {
+            if(ctx->reuse[i] > 0)
+                fprintf(fp, "%lu,%lu,%ld\n", 1UL << i, (1UL << i << 1) - 1, ctx->reuse[i]);
+        }
+    }
+    int failed = ferror(fp);
+    if(fclose(fp) != 0 || failed) {
+        fprintf(stderr, "Profile %s could not be written to.\n", path);
+        return -1;
+    }
+    return 0;
+}
+/*
+ * Starts logging faults, evictions, TLB fills, shootdowns and page moves to
+ * the given file(see eventlog.h), replacing any log already open. Every
+ * event is stamped with the number of the reference that caused it.
+ * Returns 0 on success, or -1 if the file could not be created.
+ */
+int vmm_open_event_log(VMM_CTX *ctx, const char *path) {
+#ifdef VMM_NO_EVENTS
+    (void)ctx;
+    fprintf(stderr, "Event log %s not written - built without event logging.\n", path);
+    return -1;
+#else
+    vmm_close_event_log(ctx);
+    ctx->events = newEventLog(path, ctx->config.numCPUs, ctx->numPages);
+    return ctx->events != NULL ? 0 : -1;
+#endif
+}
+/*
+ * Writes out every event logged so far and closes the log.
+ * Returns the number of events written, 0 if no log was open, or -1 if the
+ * file could not be written.
+ */
+long vmm_close_event_log(VMM_CTX *ctx) {
+    if(ctx->events == NULL)
+        return 0;
+    long written = freeEventLog(ctx->events);
+    ctx->events = NULL;
+    if(written < 0)
+        fprintf(stderr, "The event log could not be written to.\n");
+    return written;
+}
+
+/*
+ * Makes sure that the given process and virtual address exist.
+ */
+static int checkAccess(VMM_CTX *ctx, int asid, unsigned int vaddr) {
+    if(asid < 0 || asid >= ctx->config.numProcesses) {
+        fprintf(stderr, "Process %d does not exist.\n", asid);
+        return -1;
+    }
+    if(vaddr >= ctx->config.virtualSize) {
+        fprintf(stderr, "Virtual address %u is outside of the program.\n", vaddr);
+        return -1;
+    }
+    return 0;
+}
+/*
+ * Translates a given page number into a frame number.
+ * First checks the TLB for a frame, and if not found, then checks the
+ * page table. If there is a page fault, then a page is loaded into memory.
+ */
+static int translateAddress(VMM_CTX *ctx, int asid, int pageNum) {
+    ctx->stats.pageAccesses++;              //Increments a stat
+    int frame = lookupTLB(ctx, asid, pageNum);
+    if(frame != -1)
+        return frame;                       //If TLB lookup was successful
+
+    frame = lookupPageTable(ctx, asid, pageNum);
+    if(frame != -1)
+        return frame;                       //If page table lookup was successful
+
+    ctx->stats.pageFaults++;                //Page fault, increment stat
+    if(ctx->profile)
+        ctx->profile[asid * ctx->numPages + pageNum].faults++;
+    ctx->victim = -1;
+    frame = loadPage(ctx, asid, pageNum);   //If page fault occurred
+    LOG_EVENT(ctx, EVENT_FAULT, asid * ctx->numPages + pageNum, frame, ctx->victim);
+    return frame;
+}
+/*
+ * Performs a lookup on the TLB for the given page number.
+ * If a frame is found, then its number is returned. If not, -1 is returned.
+ */
+static int lookupTLB(VMM_CTX *ctx, int asid, int pageNum) {
+    ctx->stats.tlbLookups++;    //Increments a stat
+    ctx->cpuStats[ctx->cpu].tlbLookups++;
+    int frame = findTLBEntry(ctx, asid, pageNum);
+    if(frame != -1) {
+        ctx->stats.tlbHits++;   //Increments a stat
+        ctx->cpuStats[ctx->cpu].tlbHits++;
+    }
+    return frame;
+}
+/*
+ * Performs a lookup on the page table for the given page number.
+ * If a frame is found, then it is cached in the TLB and returned. If not, -1
+ * is returned.
+ */
+static int lookupPageTable(VMM_CTX *ctx, int asid, int pageNum) {
+    int frameNumber = getFrameNumber(ctx->pageTables[asid], pageNum);
+    if(frameNumber == -1)
+        return -1;
+    addTLBEntry(ctx, asid, pageNum, frameNumber);
+    return frameNumber;
+}
+/*
+ * In the event of a page fault, the needed page must be loaded into memory.
+ * Its content comes from the compressed swap tier if it is enabled and holds
+ * the page, then from the page's written-back copy, and otherwise from the
+ * backing store. A page that was dirty in the pool stays dirty, as the pool
+ * held its only copy. Pages of nothing but zeros are mapped to the shared zero page
+ * instead of taking a frame, if that is enabled.
+ */
+static int loadPage(VMM_CTX *ctx, int asid, int pageNum) {
+    int vpn = asid * ctx->numPages + pageNum;
+    char *data = malloc(sizeof(char) * ctx->config.pageSize);
+    assert(data != 0);
+    int dirty = 0;
+    if(ctx->zswap != NULL && loadZSWAP(ctx->zswap, vpn, data, &dirty)) {
+        if(dirty || ctx->swap[vpn] != NULL)     //A page never written would have come from the backing store
+            ctx->stats.swapReadsAvoided++;
+    } else {
+        if(ctx->swap[vpn] != NULL) {
+            memcpy(data, ctx->swap[vpn], ctx->config.pageSize);
+            ctx->stats.swapReads++;
+        } else {
+            readBackingStore(ctx, pageNum, data);
+        }
+        accessSwap(ctx, vpn, 0);
+    }
+    if(ctx->config.zeroPages && isZeroPage(data, ctx->config.pageSize)) {
+        free(data);
+        ctx->stats.zeroFaults++;
+        mapPage(ctx, ctx->zeroPage, asid, pageNum);
+        addTLBEntry(ctx, asid, pageNum, ctx->zeroPage->frameNum);
+        return ctx->zeroPage->frameNum;
+    }
+    int frame = installPage(ctx, asid, pageNum, data);
+    getPage(ctx, frame)->dirty = dirty;
+    return frame;
+}
+/*
+ * Gives the writing process its own copy of a shared page.
+ * Returns the frame of the copy.
+ */
+static int copyOnWrite(VMM_CTX *ctx, int asid, int pageNum, PAGE *shared) {
+    ctx->stats.cowFaults++;
+    if(shared == ctx->zeroPage)
+        ctx->stats.zeroCowFaults++;
+    char *data = malloc(sizeof(char) * ctx->config.pageSize);
+    assert(data != 0);
+    memcpy(data, shared->content, ctx->config.pageSize);
+
+    int sharedFrame = shared->frameNum;
+    unmapPage(ctx, shared, asid, pageNum);  //The shared page may be evicted to make room
+    setTLBEntry(ctx, asid, pageNum, -1);
+    int frame = installPage(ctx, asid, pageNum, data);
+    LOG_EVENT(ctx, EVENT_COW, asid * ctx->numPages + pageNum, frame, sharedFrame);
+    return frame;
+}
+/*
+ * Places the given content in a frame, making room first if there is none.
+ * The frame is then mapped by the page table and TLB.
+ */
+static int installPage(VMM_CTX *ctx, int asid, int pageNum, char *data) {
+    int index = allocateFrame(ctx, placementNode(ctx, asid, pageNum));
+    PAGE *page = newPAGE(index, data);
+    mapPage(ctx, page, asid, pageNum);
+    pushPageLRU(ctx, page);
+    placeFrame(ctx, index, page);
+    addTLBEntry(ctx, asid, pageNum, index);
+    return index;
+}
+/*
+ * Finds an empty frame in the fast tier, on the given node if it has one and
+ * otherwise on the nearest node(by number) that does. If there is none at
+ * all, the least recently used page is demoted to the slow tier, or swapped
+ * out if there is no slow tier, in favor of the new one, wherever it is.
+ */
+static int allocateFrame(VMM_CTX *ctx, int node) {
+    if(ctx->freeFrames - ctx->nodeFree[ctx->slowNode] <= 0) {  //No space
+        PAGE *lru = popPageLRU(ctx->pageStack);
+        if(lru == NULL) {
+            fprintf(stderr, "Could not remove the LRU page, exiting...\n");
+            exit(-4);
+        }
+        int frame = lru->frameNum;
+        ctx->victim = firstMapping(ctx, lru);
+        if(ctx->config.slowSize > 0)
+            demotePage(ctx, lru);
+        else
+            evictPage(ctx, lru);
+        return frame;
+    }
+    for(int i=0; i<ctx->config.numNodes; i++) {
+        int index = freeFrameOnNode(ctx, (node + i) % ctx->config.numNodes);
+        if(index != -1)
+            return index;
+    }
+    fprintf(stderr, "Error loading page - No space was found for new page.\n");
+    exit(-3);   //Fatal eror - should never reach here
+}
+/*
+ * Removes a page(already taken off the LRU stack) from memory. Every mapping
+ * is torn down, and the compressed swap tier keeps a copy for each if it is
+ * enabled. Dirty content is written back to swap only if the tier is off or
+ * rejects it; otherwise it is written when the tier evicts it.
+ */
+static void evictPage(VMM_CTX *ctx, PAGE *p) {
+    for(MAPPING *m = p->mappings; m != NULL; m = m->next) {
+        int vpn = m->asid * ctx->numPages + m->pageNum;
+        removePageTableEntry(ctx->pageTables[m->asid], m->pageNum);
+        setTLBEntry(ctx, m->asid, m->pageNum, -1);
+        LOG_EVENT(ctx, EVENT_EVICT, vpn, p->frameNum, -1);
+        if(ctx->profile)
+            ctx->profile[vpn].evictions++;
+        int stored = ctx->zswap != NULL && storeZSWAP(ctx->zswap, vpn, p->content, p->dirty);
+        if(p->dirty && !stored)
+            writeSwap(ctx, vpn, p->content);
+    }
+    clearFrame(ctx, p->frameNum);
+    freePAGE(p);
+}
+/*
+ * Writes a page's content to its copy in the swap area, charging the swap
+ * device for it. Takes the context as a void pointer so the compressed swap
+ * tier can call it for the dirty entries it evicts.
+ */
+static void writeSwap(void *arg, int vpn, const char *content) {
+    VMM_CTX *ctx = arg;
+    if(ctx->swap[vpn] == NULL) {
+        ctx->swap[vpn] = malloc(ctx->config.pageSize);
+        assert(ctx->swap[vpn] != 0);
+    }
+    memcpy(ctx->swap[vpn], content, ctx->config.pageSize);
+    ctx->stats.swapWrites++;
+    accessSwap(ctx, vpn, 1);
+}
+/*
+ * Frees a page that nothing maps any more.
+ */
+static void releasePage(VMM_CTX *ctx, PAGE *p) {
+    removePageLRU(ctx, p);
+    clearFrame(ctx, p->frameNum);
+    freePAGE(p);
+}
+/*
+ * Returns the first empty frame on the given node, or -1 if it is full.
+ */
+static int freeFrameOnNode(VMM_CTX *ctx, int node) {
+    if(ctx->nodeFree[node] == 0)
+        return -1;
+    for(int index=ctx->nodeStart[node]; index<ctx->nodeStart[node+1]; index++) {
+        if(ctx->frames[index] == NULL)
+            return index;
+    }
+    return -1;
+}
+/*
+ * Fill and empty a frame, keeping count of the free frames of each node.
+ */
+static void placeFrame(VMM_CTX *ctx, int frameNum, PAGE *p) {
+    ctx->frames[frameNum] = p;
+    ctx->freeFrames--;
+    ctx->nodeFree[nodeOfFrame(ctx, frameNum)]--;
+}
+static void clearFrame(VMM_CTX *ctx, int frameNum) {
+    ctx->frames[frameNum] = NULL;
+    ctx->freeFrames++;
+    ctx->nodeFree[nodeOfFrame(ctx, frameNum)]++;
+}
+/*
+ * Returns the NUMA node holding the given frame(slowNode for the slow tier).
+ * The zero page is on every node, so -1 is returned for it.
+ */
+static int nodeOfFrame(VMM_CTX *ctx, int frameNum) {
+    if(frameNum >= ctx->numFrames)
+        return -1;
+    int node = 0;
+    while(frameNum >= ctx->nodeStart[node+1])
+        node++;
+    return node;
+}
+/*
+ * The home node of the current reference: that of its CPU when there are
+ * several, and otherwise that of its process.
+ */
+static int homeNode(VMM_CTX *ctx, int asid) {
+    return (ctx->config.numCPUs > 1 ? ctx->cpu : asid) % ctx->config.numNodes;
+}
+/*
+ * Picks the node for a new page according to the placement policy.
+ */
+static int placementNode(VMM_CTX *ctx, int asid, int pageNum) {
+    switch(ctx->config.numaPolicy) {
+    case VMM_NUMA_INTERLEAVE:
+        return (asid * ctx->numPages + pageNum) % ctx->config.numNodes;
+    case VMM_NUMA_PREFERRED:
+        return ctx->config.preferredNode;
+    default:
+        return homeNode(ctx, asid);
+    }
+}
+/*
+ * Counts count accesses to a frame from the given home node, and their
+ * modelled latency, which also moves the current CPU's clock on. Accesses to
+ * the slow tier are neither local nor remote.
+ */
+static void accountAccess(VMM_CTX *ctx, int frameNum, int home, long count) {
+    int node = nodeOfFrame(ctx, frameNum);
+    if(node == -1)
+        node = home;
+    ctx->stats.dramOnlyTime += ctx->config.nodeLatency[node == ctx->slowNode ? home : node] * count;
+    if(node == ctx->slowNode) {
+        ctx->stats.slowAccesses += count;
+        ctx->stats.slowTime += ctx->config.slowLatency * count;
+        ctx->stats.memoryTime += ctx->config.slowLatency * count;
+        ctx->cpuStats[ctx->cpu].clock += ctx->config.slowLatency * count;
+        return;
+    }
+    long latency = ctx->config.nodeLatency[node];
+    if(node == home) {
+        ctx->stats.localAccesses += count;
+    } else {
+        ctx->stats.remoteAccesses += count;
+        latency += ctx->config.remoteLatency;
+    }
+    ctx->stats.memoryTime += latency * count;
+    ctx->cpuStats[ctx->cpu].clock += latency * count;
+}
+/*
+ * An AutoNUMA sample(hinting fault) of an access to the given page from the
+ * home node. A page sampled from the same remote node twice in a row is
+ * migrated there, if that node has a free frame.
+ */
+static void sampleNUMA(VMM_CTX *ctx, PAGE *p, int home) {
+    int last = p->lastNode, node = nodeOfFrame(ctx, p->frameNum);
+    p->lastNode = home;
+    if(last == home && node != home && node != ctx->slowNode)  //Slow pages wait for promotion
+        migratePage(ctx, p, home);
+}
+/*
+ * Moves a page to a free frame on the given node, keeping its place in the
+ * LRU stack.
+ */
+static void migratePage(VMM_CTX *ctx, PAGE *p, int node) {
+    int to = freeFrameOnNode(ctx, node);
+    if(to == -1) {
+        ctx->stats.migrationFailures++;
+        return;
+    }
+    int from = p->frameNum;
+    movePage(ctx, p, to);
+    LOG_EVENT(ctx, EVENT_MIGRATE, firstMapping(ctx, p), to, from);
+    ctx->stats.numaMigrations++;
+    ctx->stats.migrationBytes += ctx->config.pageSize;
+}
+/*
+ * A sample of an access to the given page for promotion. A page in the slow
+ * tier sampled promoteThreshold times since it was demoted is promoted to a
+ * free frame in the fast tier, preferably on the home node. If the fast tier
+ * is full, its least recently used page is demoted to make room.
+ */
+static void samplePromotion(VMM_CTX *ctx, PAGE *p, int home) {
+    if(nodeOfFrame(ctx, p->frameNum) != ctx->slowNode || ++p->heat < ctx->config.promoteThreshold)
+        return;
+    removePageLRU(ctx, p);
+    int from = p->frameNum, to = -1;
+    for(int i=0; i<ctx->config.numNodes && to == -1; i++)
+        to = freeFrameOnNode(ctx, (home + i) % ctx->config.numNodes);
+    clearFrame(ctx, p->frameNum);   //Leaves room for the page demoted in its place
+    if(to == -1) {
+        PAGE *cold = popPageLRU(ctx->pageStack);
+        to = cold->frameNum;
+        demotePage(ctx, cold);
+    }
+    remapPage(ctx, p, to);
+    pushPageLRU(ctx, p);
+    LOG_EVENT(ctx, EVENT_PROMOTE, firstMapping(ctx, p), to, from);
+    p->heat = 0;
+    ctx->stats.promotions++;
+}
+/*
+ * Moves a page(already taken off the fast tier's LRU stack) to the front of
+ * the slow tier, swapping out the least recently used slow page if the tier
+ * is full.
+ */
+static void demotePage(VMM_CTX *ctx, PAGE *p) {
+    int to = freeFrameOnNode(ctx, ctx->slowNode);
+    if(to == -1) {
+        PAGE *lru = popPageLRU(ctx->slowStack);
+        to = lru->frameNum;
+        evictPage(ctx, lru);
+    }
+    int from = p->frameNum;
+    movePage(ctx, p, to);
+    pushPageLRU(ctx, p);
+    LOG_EVENT(ctx, EVENT_DEMOTE, firstMapping(ctx, p), to, from);
+    p->heat = 0;
+    ctx->stats.demotions++;
+}
+/*
+ * Copies a page to the given free frame and frees its old one.
+ */
+static void movePage(VMM_CTX *ctx, PAGE *p, int frameNum) {
+    clearFrame(ctx, p->frameNum);
+    remapPage(ctx, p, frameNum);
+}
+/*
+ * Puts a page(whose old frame has been freed) in the given free frame. Every
+ * mapping of it is pointed at the new frame, shooting down the TLB entries
+ * of other CPUs.
+ */
+static void remapPage(VMM_CTX *ctx, PAGE *p, int frameNum) {
+    p->frameNum = frameNum;
+    placeFrame(ctx, frameNum, p);
+    for(MAPPING *m = p->mappings; m != NULL; m = m->next) {
+        addPageTableEntry(ctx->pageTables[m->asid], m->pageNum, frameNum);
+        setTLBEntry(ctx, m->asid, m->pageNum, frameNum);
+    }
+}
+/*
+ * Reads the given page from the backing store into data.
+ */
+static void readBackingStore(VMM_CTX *ctx, int pageNum, char *data) {
+    unsigned int pageSize = ctx->config.pageSize;
+    ctx->stats.backingStoreReads++;
+    if(ctx->stagedSlot[pageNum] != -1) {    //Already read by a batch
+        memcpy(data, ctx->staged + (size_t)ctx->stagedSlot[pageNum] * pageSize, pageSize);
+        return;
+    }
+    fseek(ctx->store, (long)pageNum * pageSize, SEEK_SET);
+    size_t got = fread(data, 1, pageSize, ctx->store);
+    memset(data + got, EOF, pageSize - got);    //Past the end of the store reads as EOF
+}
+/*
+ * Makes a read or write-back of the given virtual page on the swap devices,
+ * if they are modelled, and moves the current CPU's clock on past any wait
+ * that costs it: the whole of a read, or room in the queue for a write.
+ */
+static void accessSwap(VMM_CTX *ctx, int vpn, int write) {
+    if(ctx->swapDevices == NULL)
+        return;
+    long *clock = &ctx->cpuStats[ctx->cpu].clock;
+    long until = submitSwap(ctx->swapDevices, *clock, vpn, write);
+    ctx->stats.swapWaitTime += until - *clock;
+    *clock = until;
+}
+static int compareInt(const void *a, const void *b) {
+    int x = *(const int *)a, y = *(const int *)b;
+    return (x > y) - (x < y);
+}
+/*
+ * Reads the pages that the given references of process 0 will fault in from
+ * the backing store, as far as the page table can tell before they are made.
+ * Runs of neighbouring pages are read with one seek. Pages that get evicted
+ * and fault again during the batch are still read from here.
+ */
+static void stageFaults(VMM_CTX *ctx, const unsigned int *vaddrs, size_t count) {
+    unsigned int pageSize = ctx->config.pageSize;
+    PAGE_TABLE *table = ctx->pageTables[0];
+    for(size_t i=0; i<count && ctx->numStaged<BATCH_STAGE_LIMIT; i++) {
+        int pageNum = (int)(vaddrs[i] >> ctx->offsetBits);
+        if(getFrameNumber(table, pageNum) == -1 && ctx->swap[pageNum] == NULL
+                && ctx->stagedSlot[pageNum] == -1) {
+            ctx->stagedSlot[pageNum] = 0;
+            ctx->stagedPages[ctx->numStaged++] = pageNum;
+        }
+    }
+    if(ctx->numStaged == 0)
+        return;
+    qsort(ctx->stagedPages, ctx->numStaged, sizeof(int), &compareInt);
+    ctx->staged = realloc(ctx->staged, (size_t)ctx->numStaged * pageSize);
+    assert(ctx->staged != 0);
+
+    for(int start=0, end; start<ctx->numStaged; start=end) {
+        for(end=start+1; end<ctx->numStaged && ctx->stagedPages[end] == ctx->stagedPages[end-1]+1; end++)
+            ;
+        char *data = ctx->staged + (size_t)start * pageSize;
+        size_t want = (size_t)(end - start) * pageSize, got = 0;
+        if(fseek(ctx->store, (long)ctx->stagedPages[start] * pageSize, SEEK_SET) == 0)
+            got = fread(data, 1, want, ctx->store);
+        memset(data + got, EOF, want - got);    //Past the end of the store reads as EOF
+        for(int i=start; i<end; i++)
+            ctx->stagedSlot[ctx->stagedPages[i]] = i;
+    }
+}
+static void unstageFaults(VMM_CTX *ctx) {
+    for(int i=0; i<ctx->numStaged; i++)
+        ctx->stagedSlot[ctx->stagedPages[i]] = -1;
+    ctx->numStaged = 0;
+}
+/*
+ * Prefetch hints for a reference of process 0 that a batch is about to make:
+ * first its page table entry, then(once that has arrived) its page.
+ */
+static void prefetchPageTable(VMM_CTX *ctx, unsigned int vaddr) {
+    __builtin_prefetch(&ctx->pageTables[0]->page_to_frame[vaddr >> ctx->offsetBits]);
+}
+static void prefetchPage(VMM_CTX *ctx, unsigned int vaddr) {
+    int frame = getFrameNumber(ctx->pageTables[0], (int)(vaddr >> ctx->offsetBits));
+    if(frame >= 0 && frame < ctx->numFrames && ctx->frames[frame] != NULL) {
+        __builtin_prefetch(ctx->frames[frame]);
+        __builtin_prefetch(ctx->frames[frame]->content + (vaddr & ctx->offsetMask));
+    }
+}
+/*
+ * Checks whether a page holds nothing but zeros, 16 bytes at a time where
+ * SSE2 is available.
+ */
+static int isZeroPage(const char *data, unsigned int size) {
+    unsigned int i = 0;
+#ifdef __SSE2__
+    __m128i acc = _mm_setzero_si128();
+    for(; i + 16 <= size; i += 16)
+        acc = _mm_or_si128(acc, _mm_loadu_si128((const __m128i *)(data + i)));
+    if(_mm_movemask_epi8(_mm_cmpeq_epi8(acc, _mm_setzero_si128())) != 0xFFFF)
+        return 0;
+#endif
+    for(; i < size; i++) {
+        if(data[i] != 0)
+            return 0;
+    }
+    return 1;
+}
+/*
+ * Returns the page held in the given frame, including the zero page.
+ */
+static PAGE *getPage(VMM_CTX *ctx, int frameNum) {
+    return frameNum == ctx->zeroPage->frameNum ? ctx->zeroPage : ctx->frames[frameNum];
+}
+/*
+ * Maps the given page at a virtual page. The zero page only counts its
+ * mappings, since it is never evicted.
+ */
+static void mapPage(VMM_CTX *ctx, PAGE *p, int asid, int pageNum) {
+    if(p == ctx->zeroPage)
+        p->refs++;
+    else
+        addMapping(p, asid, pageNum);
+    addPageTableEntry(ctx->pageTables[asid], pageNum, p->frameNum);
+}
+static void unmapPage(VMM_CTX *ctx, PAGE *p, int asid, int pageNum) {
+    if(p == ctx->zeroPage)
+        p->refs--;
+    else
+        removeMapping(p, asid, pageNum);
+    removePageTableEntry(ctx->pageTables[asid], pageNum);
+}
+/*
+ * Counts an access to the given virtual page, and the number of references
+ * since its previous one in the reuse distance histogram.
+ */
+static void profileAccess(VMM_CTX *ctx, int vpn) {
+    PAGE_PROFILE *prof = &ctx->profile[vpn];
+    long now = ctx->stats.pageAccesses;
+    prof->accesses++;
+    if(prof->lastAccess == 0)
+        ctx->coldAccesses++;
+    else
+        ctx->reuse[63 - __builtin_clzll((unsigned long long)(now - prof->lastAccess))]++;
+    prof->lastAccess = now;
+}
+/*
+ * Returns the first virtual page(across every address space) mapping the
+ * given page, or -1 if there is none. Events about a page are logged under it.
+ */
+static int firstMapping(VMM_CTX *ctx, PAGE *p) {
+    return p->mappings != NULL ? p->mappings->asid * ctx->numPages + p->mappings->pageNum : -1;
+}
+/*
+ * Marks the page held in the given frame as the most recently used one.
+ * Returns that page. The zero page takes no part in replacement.
+ */
+static PAGE *touchFrame(VMM_CTX *ctx, int frameNum) {
+    PAGE *page = getPage(ctx, frameNum);
+    if(page == ctx->zeroPage)
+        return page;
+    if(page != NULL)
+        updatePageLRU(ctx, page);
+    else
+        fprintf(stderr, "Could not read from frame at location %d.\n", frameNum);
+    return page;
+}
+
+/*
+ * Each tier has an LRU stack of its own, which its pages are pushed onto and
+ * removed from by their frame. Every resident page remembers its node in
+ * that stack, so none of these have to search for it.
+ */
+static DLL *stackOf(VMM_CTX *ctx, PAGE *p) {
+    return p->frameNum >= ctx->nodeStart[ctx->slowNode] ? ctx->slowStack : ctx->pageStack;
+}
+static void pushPageLRU(VMM_CTX *ctx, PAGE *p) {
+    p->lru = insertNodeDLL(stackOf(ctx, p), 0, p);
+}
+static void updatePageLRU(VMM_CTX *ctx, PAGE *p) {
+    frontNodeDLL(stackOf(ctx, p), p->lru);
+}
+static PAGE *popPageLRU(DLL *stack) {
+    PAGE *p = removeDLL(stack, sizeDLL(stack)-1);
+    p->lru = NULL;
+    p->lastNode = -1;
+    return p;
+}
+static void removePageLRU(VMM_CTX *ctx, PAGE *p) {
+    removeNodeDLL(stackOf(ctx, p), p->lru);
+    p->lru = NULL;
+}
+
+/*
+ * The TLBs are tagged with the virtual page's index across every address
+ * space. Lookups and fills use the TLB of the CPU making the reference.
+ */
+static void addTLBEntry(VMM_CTX *ctx, int asid, int pageNum, int frameNum) {
+    int32_t replaced = addTLB(ctx->tlbs[ctx->cpu], asid * ctx->numPages + pageNum, frameNum);
+    LOG_EVENT(ctx, EVENT_TLB_FILL, asid * ctx->numPages + pageNum, frameNum, replaced);
+}
+static int findTLBEntry(VMM_CTX *ctx, int asid, int pageNum) {
+    return findTLB(ctx->tlbs[ctx->cpu], asid * ctx->numPages + pageNum);
+}
+/*
+ * Changing a mapping reaches every TLB. Each other CPU that held it must be
+ * interrupted to drop(or update) its entry; together those IPIs make up one
+ * shootdown.
+ */
+static void setTLBEntry(VMM_CTX *ctx, int asid, int pageNum, int frameNum) {
+    int32_t tag = asid * ctx->numPages + pageNum;
+    long ipis = 0;
+    for(int c=0; c<ctx->config.numCPUs; c++) {
+        if(setTLB(ctx->tlbs[c], tag, frameNum) > 0 && c != ctx->cpu) {
+            ctx->cpuStats[c].ipisReceived++;
+            ipis++;
+        }
+    }
+    if(ipis > 0) {
+        LOG_EVENT(ctx, EVENT_SHOOTDOWN, tag, frameNum, (int)ipis);
+        ctx->stats.tlbShootdowns++;
+        ctx->stats.shootdownIPIs += ipis;
+        ctx->stats.shootdownCycles += ipis * ctx->config.ipiCycles;
+    }
+}
@@ -0,0 +1,166 @@
+#ifndef VMM_H
+#define VMM_H
+
+#include <stddef.h>
+
+/*
+ * libvmm - the virtual memory simulator as a library.
+ *
+ * Every simulator instance lives in its own VMM_CTX, created from a
+ * VMM_CONFIG. There is no global state, so separate instances can be driven
+ * from separate threads without any locking. A single instance is not
+ * thread safe; several threads may share one(for instance one per simulated
+ * CPU) only if they take turns.
+ */
+typedef struct vmm_ctx VMM_CTX;
+
+#define VMM_MAX_NODES 8
+#define VMM_NUMA_FIRST_TOUCH 0  //New pages go to the node of the CPU(or process) touching them
+#define VMM_NUMA_INTERLEAVE 1   //New pages go round the nodes by page number
+#define VMM_NUMA_PREFERRED 2    //New pages go to one node while it has room
+#define VMM_IO_FIFO 0           //Swap requests are served in the order they were made
+#define VMM_IO_ELEVATOR 1       //Swap requests are served sweeping up and down the device
+#define VMM_IO_DEADLINE 2       //Like the elevator, but requests waiting too long go first
+
+/*
+ * Describes the geometry of a simulator instance. Sizes are in bytes and the
+ * page size must be a power of two that divides every memory size.
+ */
+typedef struct vmm_config {
+    const char *backingStore;   //Location of the "program" on disk
+    unsigned int pageSize;      //Size of each page in bytes
+    unsigned int virtualSize;   //Size of the "program" in bytes
+    unsigned int physicalSize;  //Size of the memory allocated to the "program" in bytes
+    unsigned int tlbSize;       //Number of entries in the TLB
+    int tlbSearch;              //TLB_* kind from tlb.h(TLB_AUTO picks the widest SIMD search available)
+    int numProcesses;           //Number of address spaces, each a view of the "program"
+    size_t zswapSize;           //Bytes of RAM for the compressed swap pool(0 disables it)
+    long dedupInterval;         //References between deduplication passes(0 disables them)
+    int zeroPages;              //Map pages of all zeros to one shared zero page
+    int numCPUs;                //Number of CPUs, each with a private TLB over the shared page tables
+    long ipiCycles;             //Modelled cost of one TLB shootdown IPI in cycles
+    int profilePages;           //Keep per-page counters and a reuse distance histogram(on by default)
+    int numNodes;               //NUMA nodes physical memory is split into
+    unsigned int nodeSize[VMM_MAX_NODES];   //Bytes of each node(all 0 splits physicalSize evenly)
+    long nodeLatency[VMM_MAX_NODES];        //Nanoseconds for an access to each node from itself
+    long remoteLatency;         //Extra nanoseconds for an access from another node
+    int numaPolicy;             //VMM_NUMA_* placement of new pages
+    int preferredNode;          //Node VMM_NUMA_PREFERRED fills first
+    long numaScanInterval;      //References between AutoNUMA samples(0 disables migration)
+    unsigned int slowSize;      //Bytes of the slow memory tier(0 disables it)
+    long slowLatency;           //Nanoseconds for an access to the slow tier
+    long promoteInterval;       //References between samples of the page accessed
+    int promoteThreshold;       //Samples in the slow tier that make a page hot enough to promote
+    int swapDevices;            //Devices the swap space is striped over(0 leaves its I/O unmodelled)
+    int swapStripe;             //Pages in each stripe unit
+    int swapDepth;              //Requests each device can hold waiting
+    int swapScheduler;          //VMM_IO_* order waiting requests are served in
+    long swapLatency;           //Nanoseconds a device takes for a page, besides seeking
+    long swapSeek;              //Nanoseconds of a seek across a whole device(0 for none, as on an SSD)
+    long swapDeadline;          //Nanoseconds a read may wait under VMM_IO_DEADLINE(writes 10 times as long)
+    int specialize;             //Let vmm_translate_batch use a loop compiled for the geometry if there is one
+} VMM_CONFIG;
+
+/*
+ * Counters accumulated by a simulator instance since it was created.
+ */
+typedef struct vmm_stats {
+    long pageAccesses, pageFaults;
+    long tlbLookups, tlbHits;
+    long backingStoreReads;
+    long swapReads, swapWrites;         //Reads and write-backs of written pages
+    long cowFaults, dedupMerges;
+    long sharedFrames, framesSaved;     //Frames currently shared, and the frames that saves
+    long zeroFaults, zeroCowFaults;     //Faults served by the zero page, and writes that broke it
+    long zeroMapped;                    //Pages currently mapping the zero page(frames saved by it)
+    long residentFrames;                //Frames currently holding a page(the resident set)
+    long zswapStores, zswapRejects, zswapHits, zswapEvictions;
+    long zswapWriteBacks;               //Evicted pool entries that were dirty, so were written to swap then
+    long zswapBytesIn, zswapBytesOut;   //Uncompressed/compressed size of all stored pages
+    long swapReadsAvoided;              //Zswap hits on pages that would otherwise have been read from swap
+    long tlbShootdowns, shootdownIPIs;  //Unmaps or remaps that other CPUs' TLBs held, and the IPIs sent
+    long shootdownCycles;               //Modelled cost of those IPIs
+    long localAccesses, remoteAccesses; //Accesses to frames on the accessing CPU's(or process') node, or not
+    long memoryTime;                    //Modelled nanoseconds of every access to a frame
+    long numaMigrations, migrationBytes, migrationFailures;
+    long slowAccesses, slowTime;        //Accesses to the slow tier, and their share of memoryTime
+    long dramOnlyTime;                  //memoryTime had the slow tier been the home node's DRAM
+    long promotions, demotions;         //Pages moved from the slow tier to the fast one, and back
+    long swapWaitTime;                  //Nanoseconds CPUs spent waiting on swap devices
+    long elapsedTime;                   //Modelled nanoseconds of the CPU that has run longest
+} VMM_STATS;
+
+/*
+ * Counters of one CPU. The matching VMM_STATS fields are the sums over every
+ * CPU.
+ */
+typedef struct vmm_cpu_stats {
+    long references;
+    long tlbLookups, tlbHits;
+    long ipisReceived;                  //Shootdowns of entries in this CPU's TLB
+    long clock;                         //Modelled nanoseconds of memory accesses and swap waits
+} VMM_CPU_STATS;
+
+/*
+ * Counters of one swap device, kept when VMM_CONFIG.swapDevices is set.
+ * Times are modelled nanoseconds.
+ */
+typedef struct vmm_swap_stats {
+    long reads, writes;                 //Requests made of the device
+    long served;                        //Requests it has taken off its queue(the rest are waiting)
+    long busyTime;                      //Time spent serving them
+    long queueDelay, maxQueueDelay;     //Total and longest time they waited in the queue
+    long fullStalls;                    //Requests that had to wait for room in a full queue
+    long seekDistance;                  //Blocks the device moved across
+} VMM_SWAP_STATS;
+
+/*
+ * Counters of one virtual page, kept when VMM_CONFIG.profilePages is set.
+ */
+typedef struct vmm_page_profile {
+    long accesses, faults, evictions;
+} VMM_PAGE_PROFILE;
+
+/*
+ * Bucket i of the reuse distance histogram counts accesses made between 2^i
+ * and 2^(i+1)-1 references after the previous access to the same page.
+ */
+#define VMM_REUSE_BUCKETS 64
+#define VMM_PROFILE_CSV 0
+#define VMM_PROFILE_BINARY 1
+
+extern void vmm_default_config(VMM_CONFIG *config);
+extern VMM_CTX *vmm_create(const VMM_CONFIG *config);
+extern void vmm_destroy(VMM_CTX *ctx);
+
+extern int vmm_translate(VMM_CTX *ctx, unsigned int vaddr, unsigned int *paddr);
+extern int vmm_read(VMM_CTX *ctx, unsigned int vaddr, unsigned int *paddr, signed char *value);
+extern int vmm_write(VMM_CTX *ctx, int asid, unsigned int vaddr, signed char value, unsigned int *paddr);
+extern int vmm_access(VMM_CTX *ctx, int asid, unsigned int vaddr, int write, signed char *value,
+        unsigned int *paddr);
+extern int vmm_access_cpu(VMM_CTX *ctx, int cpu, int asid, unsigned int vaddr, int write,
+        signed char *value, unsigned int *paddr);
+extern int vmm_read_run(VMM_CTX *ctx, int cpu, int asid, unsigned int page, const unsigned int *offsets,
+        long count, unsigned int *paddrs, signed char *values);
+extern size_t vmm_translate_batch(VMM_CTX *ctx, const unsigned int *vaddrs, size_t count,
+        unsigned int *paddrs, signed char *values);
+
+extern int vmm_fork(VMM_CTX *ctx, int parent, int child);
+extern int vmm_fork_cpu(VMM_CTX *ctx, int cpu, int parent, int child);
+extern long vmm_dedup(VMM_CTX *ctx);
+
+extern int vmm_checkpoint(const VMM_CTX *ctx, const char *path, long refIndex);
+extern VMM_CTX *vmm_restore(const char *path, const char *backingStore, long *refIndex);
+
+extern void vmm_get_config(const VMM_CTX *ctx, VMM_CONFIG *config);
+extern const char *vmm_batch_variant(const VMM_CTX *ctx);
+extern void vmm_get_stats(const VMM_CTX *ctx, VMM_STATS *stats);
+extern int vmm_get_cpu_stats(const VMM_CTX *ctx, int cpu, VMM_CPU_STATS *stats);
+extern int vmm_get_swap_stats(const VMM_CTX *ctx, int device, VMM_SWAP_STATS *stats);
+extern int vmm_get_page_profile(const VMM_CTX *ctx, int asid, int page, VMM_PAGE_PROFILE *profile);
+extern long vmm_get_reuse_histogram(const VMM_CTX *ctx, long *buckets);
+extern int vmm_write_profile(const VMM_CTX *ctx, const char *path, int format);
+extern int vmm_open_event_log(VMM_CTX *ctx, const char *path);
+extern long vmm_close_event_log(VMM_CTX *ctx);
+
+#endif
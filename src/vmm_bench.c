@@ -0,0 +1,139 @@
+#define _POSIX_C_SOURCE 200809L  //For clock_gettime
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "vmm.h"
+
+#define REFERENCES 2000000L
+#define BATCH_SIZE 4096
+#define REPEATS 5
+
+#define MODES 3
+
+/*
+ * Measures references per second of vmm_read one address at a time against
+ * vmm_translate_batch over the same trace, with the batch loop compiled for
+ * the geometry(if there is one) and with the generic loop, and checks that
+ * all three produce the same physical addresses, values and statistics.
+ * About 90% of the references fall in a hot quarter of the "program", so
+ * there are TLB hits, page table hits and faults alike; larger pages make
+ * most of them TLB hits, and more memory fewer faults. Every mode is run
+ * repeats times, taking turns so that drift in the machine's speed falls on
+ * all of them alike, and the median rate of each is reported, with the
+ * median of the specialized loop's speedup over the generic one in each
+ * round. Usage: vmm_bench [store] [references] [page_size] [tlb_size]
+ * [physical_bytes] [repeats]
+ */
+static double median(double *rates, int n);
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char **argv) {
+    VMM_CONFIG config;
+    vmm_default_config(&config);
+    config.backingStore = argc > 1 ? argv[1] : "../BACKING_STORE.bin";
+    long count = argc > 2 ? atol(argv[2]) : REFERENCES;
+    config.physicalSize = config.virtualSize / 4;
+    if(argc > 3)
+        config.pageSize = (unsigned int)atoi(argv[3]);
+    if(argc > 4)
+        config.tlbSize = (unsigned int)atoi(argv[4]);
+    if(argc > 5)
+        config.physicalSize = (unsigned int)atoi(argv[5]);
+    int repeats = argc > 6 ? atoi(argv[6]) : REPEATS;
+    if(repeats < 1)
+        repeats = 1;
+
+    unsigned int *vaddrs = malloc(sizeof(unsigned int) * count);
+    unsigned int *paddrs[MODES];
+    signed char *values[MODES];
+    for(int mode=0; mode<MODES; mode++) {
+        paddrs[mode] = malloc(sizeof(unsigned int) * count);
+        values[mode] = malloc(count);
+        if(!vaddrs || !paddrs[mode] || !values[mode]) {
+            fprintf(stderr, "Could not allocate %ld references.\n", count);
+            return 1;
+        }
+    }
+    srand(1);
+    for(long i=0; i<count; i++) {
+        unsigned int range = rand() % 10 ? config.virtualSize / 4 : config.virtualSize;
+        vaddrs[i] = (unsigned int)rand() % range;
+    }
+
+    VMM_STATS stats[MODES];
+    double *rates[MODES + 1];   //The last holds the speedup of each round
+    for(int mode=0; mode<=MODES; mode++) {
+        rates[mode] = malloc(sizeof(double) * repeats);
+        if(!rates[mode]) {
+            fprintf(stderr, "Could not allocate %d repeats.\n", repeats);
+            return 1;
+        }
+    }
+    const char *variant = NULL;
+    for(int r=0; r<repeats; r++) {
+        for(int mode=0; mode<MODES; mode++) {    //Single, generic batch, specialized batch
+            config.specialize = mode == 2;
+            VMM_CTX *ctx = vmm_create(&config);
+            if(ctx == NULL)
+                return 1;
+            double start = now();
+            if(mode == 0) {
+                for(long i=0; i<count; i++)
+                    vmm_read(ctx, vaddrs[i], &paddrs[0][i], &values[0][i]);
+            } else {
+                for(long i=0; i<count; i+=BATCH_SIZE) {
+                    size_t n = count - i < BATCH_SIZE ? (size_t)(count - i) : BATCH_SIZE;
+                    vmm_translate_batch(ctx, vaddrs + i, n, paddrs[mode] + i, values[mode] + i);
+                }
+            }
+            rates[mode][r] = count / (now() - start);
+            vmm_get_stats(ctx, &stats[mode]);
+            if(mode == 2)
+                variant = vmm_batch_variant(ctx);
+            vmm_destroy(ctx);
+        }
+        rates[MODES][r] = rates[2][r] / rates[1][r];
+    }
+
+    int same = 1;
+    for(int mode=1; mode<MODES; mode++) {
+        same &= memcmp(paddrs[0], paddrs[mode], sizeof(unsigned int) * count) == 0
+                && memcmp(values[0], values[mode], count) == 0
+                && memcmp(&stats[0], &stats[mode], sizeof(VMM_STATS)) == 0;
+    }
+    printf("%10s %16s (median of %d)\n", "mode", "references/sec", repeats);
+    printf("%10s %16.0f\n", "single", median(rates[0], repeats));
+    printf("%10s %16.0f\n", "batch", median(rates[1], repeats));
+    printf("%10s %16.0f (%s, %.2fx the generic batch)\n", "special", median(rates[2], repeats), variant,
+            median(rates[MODES], repeats));
+    printf("Page Faults = %ld, TLB Hits = %ld, results %s\n", stats[0].pageFaults, stats[0].tlbHits,
+            same ? "identical" : "DIFFER");
+    for(int mode=0; mode<MODES; mode++) {
+        free(paddrs[mode]);
+        free(values[mode]);
+    }
+    for(int mode=0; mode<=MODES; mode++)
+        free(rates[mode]);
+    free(vaddrs);
+    return same ? 0 : 1;
+}
+
+/*
+ * Returns the median of the given rates, which it sorts.
+ */
+static double median(double *rates, int n) {
+    for(int i=1; i<n; i++) {    //Insertion sort; there are only a few
+        double r = rates[i];
+        int j = i;
+        for(; j>0 && rates[j-1] > r; j--)
+            rates[j] = rates[j-1];
+        rates[j] = r;
+    }
+    return n % 2 ? rates[n/2] : (rates[n/2 - 1] + rates[n/2]) / 2;
+}
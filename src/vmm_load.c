@@ -0,0 +1,352 @@
+#define _POSIX_C_SOURCE 200809L  //For clock_gettime, nanosleep and getopt
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "vmm_proto.h"
+
+#define CONNECT_TRIES 100       //The server may still be starting
+#define CONNECT_WAIT_NS 10000000L
+#define DEFAULT_VIRTUAL_SIZE 65536
+#define STATS_LINES 5           //Those printed by lru for every run
+#define MAX_COUNTERS 256        //Room for the statistics of any server
+
+/*
+ * The work of one client thread and the latency of each of its requests.
+ */
+typedef struct load_client {
+    pthread_t thread;
+    const char *path;
+    long requests;
+    int batch, instance, op;
+    unsigned int virtualSize;
+    uint64_t seed;
+    double *latencies;          //In seconds, one per request
+    int failed;
+} LOAD_CLIENT;
+
+static double now(void);
+static int connectTo(const char *path);
+static int sendAll(int fd, const void *data, size_t size);
+static int recvAll(int fd, void *data, size_t size);
+static int request(int fd, int op, int instance, const unsigned int *vaddrs, uint32_t count,
+        PROTO_HEADER *reply, unsigned int *paddrs, signed char *values, int64_t *counters);
+static void *runClient(void *arg);
+static int replayTrace(const char *path, const char *trace, int batch, int instance, unsigned int virtualSize);
+static int compareLatency(const void *a, const void *b);
+
+/*
+ * Drives a running vmm_server. By default it opens -c connections that each
+ * send requests translating(or reading, with "-o read") batches of
+ * addresses, about 90% of them in a hot quarter of the "program" as in
+ * vmm_bench, and reports the throughput and latency percentiles over every
+ * request. With "-t trace" it instead resets the instance, reads the
+ * trace's addresses through it in order and prints what lru prints for the
+ * same trace, so the two can be compared.
+ */
+int main(int argc, char **argv) {
+    int clients = 4, batch = 64, instance = 0, op = PROTO_TRANSLATE;
+    long requests = 10000;
+    unsigned int virtualSize = DEFAULT_VIRTUAL_SIZE;
+    const char *trace = NULL;
+    int opt;
+    while((opt = getopt(argc, argv, "c:n:b:I:o:v:t:")) != -1) {
+        switch(opt) {
+        case 'c':   //Concurrent clients
+            clients = atoi(optarg);
+            break;
+        case 'n':   //Requests per client
+            requests = atol(optarg);
+            break;
+        case 'b':   //Addresses per request
+            batch = atoi(optarg);
+            break;
+        case 'I':   //Instance sent to
+            instance = atoi(optarg);
+            break;
+        case 'o':   //translate or read
+            if(strcmp(optarg, "translate") == 0)
+                op = PROTO_TRANSLATE;
+            else if(strcmp(optarg, "read") == 0)
+                op = PROTO_READ;
+            else
+                argc = -1;
+            break;
+        case 'v':   //Size of the "program", which addresses are taken modulo
+            virtualSize = (unsigned int)strtoul(optarg, NULL, 0);
+            break;
+        case 't':
+            trace = optarg;
+            break;
+        default:
+            argc = -1;  //Forces the usage message below
+        }
+    }
+    if(argc - optind != 1 || clients < 1 || requests < 1 || batch < 1 || batch > PROTO_MAX_BATCH
+            || instance < 0 || instance > UINT16_MAX || virtualSize == 0) {
+        fprintf(stderr, "Incorrect usage of parameters. Correct usage: %s [-c clients] [-n requests] [-b batch] [-I instance] [-o translate|read] [-v virtual_size] [-t trace] <socket>\n", argv[0]);
+        return -1;
+    }
+    if(trace != NULL)
+        return replayTrace(argv[optind], trace, batch, instance, virtualSize);
+
+    LOAD_CLIENT *load = calloc(clients, sizeof(LOAD_CLIENT));
+    if(load == NULL) {
+        fprintf(stderr, "Could not allocate %d clients.\n", clients);
+        return -2;
+    }
+    double *latencies = NULL;
+    int started = 0, rc = 0;
+    double start = now();
+    for(int i=0; i<clients; i++, started++) {
+        load[i].path = argv[optind];
+        load[i].requests = requests;
+        load[i].batch = batch;
+        load[i].instance = instance;
+        load[i].op = op;
+        load[i].virtualSize = virtualSize;
+        load[i].seed = 0x9E3779B97F4A7C15ull * (i + 1);
+        load[i].latencies = malloc(sizeof(double) * requests);
+        if(load[i].latencies == NULL || pthread_create(&load[i].thread, NULL, &runClient, &load[i]) != 0) {
+            fprintf(stderr, "Could not start client %d.\n", i);
+            rc = -2;
+            break;
+        }
+    }
+    int failed = 0;
+    for(int i=0; i<started; i++) {    //Those already started finish before their latencies are freed
+        pthread_join(load[i].thread, NULL);
+        failed |= load[i].failed;
+    }
+    double elapsed = now() - start;
+    if(rc == 0 && failed)
+        rc = -3;
+    if(rc != 0)
+        goto done;
+
+    long total = (long)clients * requests;
+    latencies = malloc(sizeof(double) * total);
+    if(latencies == NULL) {
+        fprintf(stderr, "Could not allocate %ld latencies.\n", total);
+        rc = -2;
+        goto done;
+    }
+    for(int i=0; i<clients; i++)
+        memcpy(latencies + (long)i * requests, load[i].latencies, sizeof(double) * requests);
+    qsort(latencies, total, sizeof(double), &compareLatency);
+    printf("Requests = %ld (Clients = %d, Batch = %d)\n", total, clients, batch);
+    printf("Requests per Second = %.0f\n", total / elapsed);
+    printf("Addresses per Second = %.0f\n", total * (double)batch / elapsed);
+    const double percentiles[] = {50, 90, 99, 99.9};
+    for(size_t p=0; p<sizeof(percentiles)/sizeof(percentiles[0]); p++) {
+        long rank = (long)(percentiles[p] / 100 * total);
+        printf("p%g Latency = %.1f us\n", percentiles[p], latencies[rank < total ? rank : total - 1] * 1e6);
+    }
+    printf("Max Latency = %.1f us\n", latencies[total - 1] * 1e6);
+done:
+    for(int i=0; i<clients; i++)
+        free(load[i].latencies);
+    free(load);
+    free(latencies);
+    return rc;
+}
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+/*
+ * Connects to the server's socket, waiting a while for it to appear.
+ * Returns the socket, or -1 on failure.
+ */
+static int connectTo(const char *path) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if(strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "Socket path %s is too long.\n", path);
+        return -1;
+    }
+    strcpy(addr.sun_path, path);
+    struct timespec wait = {0, CONNECT_WAIT_NS};
+    for(int tries=0; tries<CONNECT_TRIES; tries++) {
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if(fd < 0)
+            break;
+        if(connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0)
+            return fd;
+        close(fd);
+        nanosleep(&wait, NULL);
+    }
+    fprintf(stderr, "Could not connect to %s.\n", path);
+    return -1;
+}
+static int sendAll(int fd, const void *data, size_t size) {
+    const unsigned char *p = data;
+    while(size > 0) {
+        ssize_t sent = write(fd, p, size);
+        if(sent < 0 && errno == EINTR)
+            continue;
+        if(sent <= 0)
+            return -1;
+        p += sent;
+        size -= (size_t)sent;
+    }
+    return 0;
+}
+static int recvAll(int fd, void *data, size_t size) {
+    unsigned char *p = data;
+    while(size > 0) {
+        ssize_t got = read(fd, p, size);
+        if(got < 0 && errno == EINTR)
+            continue;
+        if(got <= 0)
+            return -1;
+        p += got;
+        size -= (size_t)got;
+    }
+    return 0;
+}
+/*
+ * Sends one request and waits for its response, storing whichever of the
+ * physical addresses, values and counters it carries where given(each
+ * NULL to discard them).
+ * Returns 0 on success, or -1 if the connection failed.
+ */
+static int request(int fd, int op, int instance, const unsigned int *vaddrs, uint32_t count,
+        PROTO_HEADER *reply, unsigned int *paddrs, signed char *values, int64_t *counters) {
+    PROTO_HEADER h = {(uint8_t)op, PROTO_OK, (uint16_t)instance, count};
+    if(sendAll(fd, &h, sizeof(h)) != 0 || (count > 0 && sendAll(fd, vaddrs, sizeof(uint32_t) * count) != 0)
+            || recvAll(fd, reply, sizeof(PROTO_HEADER)) != 0)
+        return -1;
+    if(reply->count > (op == PROTO_STATS ? MAX_COUNTERS : PROTO_MAX_BATCH))
+        return -1;
+    size_t size = 0;
+    if(op == PROTO_TRANSLATE)
+        size = sizeof(uint32_t) * reply->count;
+    else if(op == PROTO_READ)
+        size = (sizeof(uint32_t) + 1) * reply->count;
+    else if(op == PROTO_STATS)
+        size = sizeof(int64_t) * reply->count;
+    unsigned char *payload = malloc(size > 0 ? size : 1);
+    if(payload == NULL || recvAll(fd, payload, size) != 0) {
+        free(payload);
+        return -1;
+    }
+    if(paddrs != NULL && (op == PROTO_TRANSLATE || op == PROTO_READ))
+        memcpy(paddrs, payload, sizeof(uint32_t) * reply->count);
+    if(values != NULL && op == PROTO_READ)
+        memcpy(values, payload + sizeof(uint32_t) * reply->count, reply->count);
+    if(counters != NULL && op == PROTO_STATS)
+        memcpy(counters, payload, size);
+    free(payload);
+    return 0;
+}
+/*
+ * Body of a client thread: sends its requests one after another, timing
+ * each from being sent to its response arriving.
+ */
+static void *runClient(void *arg) {
+    LOAD_CLIENT *c = arg;
+    int fd = connectTo(c->path);
+    unsigned int *vaddrs = malloc(sizeof(unsigned int) * c->batch);
+    if(fd < 0 || vaddrs == NULL) {
+        c->failed = 1;
+        free(vaddrs);
+        return NULL;
+    }
+    uint64_t x = c->seed;
+    for(long r=0; r<c->requests; r++) {
+        for(int i=0; i<c->batch; i++) {
+            x ^= x << 13;   //xorshift64
+            x ^= x >> 7;
+            x ^= x << 17;
+            unsigned int range = x % 10 ? c->virtualSize / 4 : c->virtualSize;
+            vaddrs[i] = (unsigned int)(x >> 32) % (range > 0 ? range : 1);
+        }
+        PROTO_HEADER reply = {0, PROTO_OK, 0, 0};
+        double sent = now();
+        if(request(fd, c->op, c->instance, vaddrs, (uint32_t)c->batch, &reply, NULL, NULL, NULL) != 0
+                || reply.status != PROTO_OK) {
+            fprintf(stderr, "Request %ld of a client failed(status %d).\n", r, reply.status);
+            c->failed = 1;
+            break;
+        }
+        c->latencies[r] = now() - sent;
+    }
+    close(fd);
+    free(vaddrs);
+    return NULL;
+}
+/*
+ * Resets the instance and reads every address in the trace(one per line)
+ * through it, printing each translation and then the statistics as lru
+ * does.
+ * Returns 0 on success, or an error code.
+ */
+static int replayTrace(const char *path, const char *trace, int batch, int instance, unsigned int virtualSize) {
+    FILE *fp = fopen(trace, "r");
+    if(fp == NULL) {
+        fprintf(stderr, "Could not open %s.\n", trace);
+        return -2;
+    }
+    int rc = 0;
+    int fd = connectTo(path);
+    unsigned int *vaddrs = malloc(sizeof(unsigned int) * batch);
+    unsigned int *paddrs = malloc(sizeof(unsigned int) * batch);
+    signed char *values = malloc(batch);
+    if(fd < 0 || vaddrs == NULL || paddrs == NULL || values == NULL) {
+        if(fd >= 0)
+            fprintf(stderr, "Could not allocate a batch of %d addresses.\n", batch);
+        rc = -3;
+        goto done;
+    }
+    PROTO_HEADER reply;
+    int error = request(fd, PROTO_RESET, instance, NULL, 0, &reply, NULL, NULL, NULL) != 0 || reply.status != PROTO_OK;
+    unsigned long vaddr;
+    int more = 1;
+    while(!error && more) {
+        uint32_t count = 0;
+        while(count < (uint32_t)batch && (more = fscanf(fp, "%lu", &vaddr) == 1))
+            vaddrs[count++] = (unsigned int)(vaddr % virtualSize);
+        if(count == 0)
+            break;
+        error = request(fd, PROTO_READ, instance, vaddrs, count, &reply, paddrs, values, NULL) != 0;
+        for(uint32_t i=0; !error && i<reply.count; i++)
+            printf("Virtual address: %u Physical address: %u Value: %d\n", vaddrs[i], paddrs[i], values[i]);
+        error = error || reply.status != PROTO_OK;
+    }
+    int64_t counters[MAX_COUNTERS];
+    if(!error)
+        error = request(fd, PROTO_STATS, instance, NULL, 0, &reply, NULL, NULL, counters) != 0
+                || reply.status != PROTO_OK || reply.count < STATS_LINES;
+    if(!error) {    //The first counters are pageAccesses, pageFaults, tlbLookups and tlbHits
+        printf("Number of Translated Addresses = %ld\n", (long)counters[0]);
+        printf("Page Faults = %ld\n", (long)counters[1]);
+        printf("Page Fault Rate = %f\n", counters[0] != 0 ? (double)counters[1]/counters[0] : -1);
+        printf("TLB Hits = %ld\n", (long)counters[3]);
+        printf("TLB Hit Rate = %f\n", counters[2] != 0 ? (double)counters[3]/counters[2] : -1);
+    } else {
+        fprintf(stderr, "Replaying %s through %s failed.\n", trace, path);
+        rc = -4;
+    }
+done:
+    fclose(fp);
+    if(fd >= 0)
+        close(fd);
+    free(vaddrs);
+    free(paddrs);
+    free(values);
+    return rc;
+}
+static int compareLatency(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
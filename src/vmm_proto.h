@@ -0,0 +1,42 @@
+#ifndef VMM_PROTO_H
+#define VMM_PROTO_H
+
+#include <stdint.h>
+
+/*
+ * The binary protocol of vmm_server. A client sends requests over a Unix
+ * domain socket and gets one response to each, in order. Every message is a
+ * PROTO_HEADER followed by a payload whose size follows from its op and
+ * count; values are in host byte order, since both ends are on one host.
+ *
+ *   op              request payload        response payload
+ *   PROTO_TRANSLATE count uint32 addresses count uint32 physical addresses
+ *   PROTO_READ      count uint32 addresses count uint32 physical addresses,
+ *                                          then count int8 values
+ *   PROTO_STATS     none                   count int64 VMM_STATS counters
+ *   PROTO_RESET     none                   none
+ *
+ * Addresses are made by process 0 of the instance named in the header, in
+ * order, as one vmm_translate_batch. If one is out of range the response
+ * has status PROTO_BAD_ADDRESS and counts only those made before it. A
+ * request of more than PROTO_MAX_BATCH addresses closes the connection.
+ */
+#define PROTO_TRANSLATE 1
+#define PROTO_READ 2
+#define PROTO_STATS 3
+#define PROTO_RESET 4       //The instance starts over from its configuration
+
+#define PROTO_OK 0
+#define PROTO_BAD_REQUEST 1 //Unknown op or instance
+#define PROTO_BAD_ADDRESS 2
+
+#define PROTO_MAX_BATCH 65536
+
+typedef struct proto_header {
+    uint8_t op;
+    uint8_t status;         //PROTO_OK in a request
+    uint16_t instance;
+    uint32_t count;
+} PROTO_HEADER;
+
+#endif
@@ -0,0 +1,479 @@
+#define _POSIX_C_SOURCE 200809L  //For sigaction and getopt
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <limits.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "vmm.h"
+#include "vmm_proto.h"
+
+#define DEFAULT_SOCKET "vmm.sock"
+#define MAX_INSTANCES 64
+#define MAX_EVENTS 64
+#define READ_CHUNK 65536
+#define READ_BUDGET (4 * READ_CHUNK)    //Bytes read from one client per turn
+#define TURN_BUDGET PROTO_MAX_BATCH     //Addresses(or requests without any) handled for one client per turn
+
+/*
+ * One connected client. Requests are read into in and handled once whole;
+ * their responses are queued in out. While a response is still being sent,
+ * no more requests are handled, so a client that stops reading only holds
+ * up itself. A turn handles a bounded share of the client's requests; whole
+ * requests left over(more) are handled on later turns, and no more is read
+ * from the client until they are.
+ */
+typedef struct client {
+    int fd;
+    unsigned char *in;
+    size_t inUsed, inSize;
+    unsigned char *out;
+    size_t outUsed, outSent, outSize;
+    int eof;                //The client will send nothing more
+    int closing;            //Close once out has been sent
+    int more;               //Whole requests are left in in
+    int backlogged;         //Counted in SERVER.backlogged
+    long turn;              //Last turn of the server it was served in
+    struct client *prev, *next;
+} CLIENT;
+
+/*
+ * The resident simulator instances, each with the configuration it is reset
+ * to, and the connected clients.
+ */
+typedef struct server {
+    VMM_CONFIG configs[MAX_INSTANCES];
+    VMM_CTX *instances[MAX_INSTANCES];
+    int numInstances;
+    unsigned int *paddrs;   //Room for the results of the largest request
+    signed char *values;
+    CLIENT *clients;
+    int backlogged;         //Clients with requests to handle and nothing to send
+    long turn;
+} SERVER;
+
+static volatile sig_atomic_t stopping = 0;
+
+static void stop(int sig);
+static int parseInstance(VMM_CONFIG *config, const char *spec);
+static int listenOn(const char *path);
+static CLIENT *newClient(SERVER *s, int fd);
+static void dropClient(SERVER *s, int epoll, CLIENT *c);
+static int readClient(CLIENT *c);
+static int writeClient(CLIENT *c);
+static int serveClient(SERVER *s, CLIENT *c);
+static void settleClient(SERVER *s, int epoll, CLIENT *c, int alive);
+static void handleRequests(SERVER *s, CLIENT *c);
+static size_t requestSize(const PROTO_HEADER *h);
+static void respond(SERVER *s, CLIENT *c, const PROTO_HEADER *h, const unsigned char *payload);
+static void appendOut(CLIENT *c, const void *data, size_t size);
+static int watch(int epoll, CLIENT *c);
+
+/*
+ * Keeps simulator instances resident and serves translate, read, stats and
+ * reset requests(see vmm_proto.h) to any number of clients over a Unix
+ * domain socket, multiplexed with epoll on one thread. Each "-i
+ * frames[:tlb_entries]" adds an instance with that many frames; there is one
+ * of the default size if none is given. Runs until interrupted.
+ */
+int main(int argc, char **argv) {
+    static SERVER server;
+    VMM_CONFIG base;
+    vmm_default_config(&base);
+    const char *path = DEFAULT_SOCKET;
+    int opt;
+    while((opt = getopt(argc, argv, "s:i:")) != -1) {
+        switch(opt) {
+        case 's':   //Path of the socket
+            path = optarg;
+            break;
+        case 'i':   //An instance, as frames[:tlb_entries]
+            if(server.numInstances == MAX_INSTANCES) {
+                fprintf(stderr, "At most %d instances can be served.\n", MAX_INSTANCES);
+                return -1;
+            }
+            server.configs[server.numInstances] = base;
+            if(parseInstance(&server.configs[server.numInstances++], optarg) != 0)
+                argc = -1;
+            break;
+        default:
+            argc = -1;  //Forces the usage message below
+        }
+    }
+    if(argc - optind != 1) {
+        fprintf(stderr, "Incorrect usage of parameters. Correct usage: %s [-s socket] [-i frames[:tlb_entries]]... <program_location>\n", argv[0]);
+        return -1;
+    }
+    if(server.numInstances == 0)
+        server.configs[server.numInstances++] = base;
+    for(int i=0; i<server.numInstances; i++) {
+        server.configs[i].backingStore = argv[optind];
+        server.instances[i] = vmm_create(&server.configs[i]);
+        if(server.instances[i] == NULL)
+            return -2;
+    }
+    server.paddrs = malloc(sizeof(unsigned int) * PROTO_MAX_BATCH);
+    server.values = malloc(PROTO_MAX_BATCH);
+    if(server.paddrs == NULL || server.values == NULL) {
+        fprintf(stderr, "Could not allocate room for %d results.\n", PROTO_MAX_BATCH);
+        return -3;
+    }
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = &stop;      //No SA_RESTART, so epoll_wait returns
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+    signal(SIGPIPE, SIG_IGN);       //A client that goes away is a write error
+
+    int listener = listenOn(path);
+    int epoll = epoll_create1(0);
+    struct epoll_event event = {EPOLLIN, {.ptr = NULL}};    //The listener is the one without a client
+    if(listener < 0 || epoll < 0 || epoll_ctl(epoll, EPOLL_CTL_ADD, listener, &event) != 0) {
+        fprintf(stderr, "Could not listen on %s.\n", path);
+        return -4;
+    }
+    fprintf(stderr, "Serving %d instance(s) on %s.\n", server.numInstances, path);
+
+    struct epoll_event events[MAX_EVENTS];
+    while(!stopping) {
+        //Backlogged clients have work without any event, so only poll for events while there are some
+        int ready = epoll_wait(epoll, events, MAX_EVENTS, server.backlogged > 0 ? 0 : -1);
+        server.turn++;
+        for(int e=0; e<ready; e++) {
+            CLIENT *c = events[e].data.ptr;
+            if(c == NULL) {     //New connections
+                int fd;
+                while((fd = accept(listener, NULL, NULL)) >= 0) {
+                    c = newClient(&server, fd);
+                    if(c != NULL)
+                        settleClient(&server, epoll, c, 1);
+                }
+                continue;
+            }
+            int alive = !(events[e].events & EPOLLERR);
+            if(alive && (events[e].events & EPOLLOUT))
+                alive = writeClient(c) == 0;
+            if(alive && (events[e].events & (EPOLLIN | EPOLLHUP)))  //A hang-up may leave requests to read
+                alive = readClient(c) == 0;
+            if(alive)
+                alive = serveClient(&server, c) == 0;
+            settleClient(&server, epoll, c, alive);
+        }
+        CLIENT *next;
+        for(CLIENT *c = server.backlogged > 0 ? server.clients : NULL; c != NULL; c = next) {
+            next = c->next;
+            if(c->backlogged && c->turn != server.turn)
+                settleClient(&server, epoll, c, serveClient(&server, c) == 0);
+        }
+    }
+
+    fprintf(stderr, "Stopping.\n");
+    while(server.clients != NULL)
+        dropClient(&server, epoll, server.clients);
+    close(epoll);
+    close(listener);
+    unlink(path);
+    for(int i=0; i<server.numInstances; i++)
+        vmm_destroy(server.instances[i]);
+    free(server.paddrs);
+    free(server.values);
+    return 0;
+}
+
+static void stop(int sig) {
+    (void)sig;
+    stopping = 1;
+}
+/*
+ * Reads an instance's memory as frames[:tlb_entries] into config, which
+ * holds its page size.
+ * Returns 0 on success, or -1 if it is malformed or out of range.
+ */
+static int parseInstance(VMM_CONFIG *config, const char *spec) {
+    char *end;
+    if(!isdigit((unsigned char)spec[0]))
+        return -1;
+    errno = 0;
+    unsigned long frames = strtoul(spec, &end, 0), tlbSize = config->tlbSize;
+    if(*end == ':') {
+        if(!isdigit((unsigned char)end[1]))
+            return -1;
+        tlbSize = strtoul(end + 1, &end, 0);
+    }
+    if(*end != '\0' || errno == ERANGE || frames == 0 || frames > UINT_MAX / config->pageSize
+            || tlbSize == 0 || tlbSize > INT_MAX)
+        return -1;
+    config->physicalSize = (unsigned int)frames * config->pageSize;
+    config->tlbSize = (unsigned int)tlbSize;
+    return 0;
+}
+/*
+ * Creates a non-blocking socket listening at the given path, replacing any
+ * stale socket left there.
+ * Returns the socket, or -1 on failure.
+ */
+static int listenOn(const char *path) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if(strlen(path) >= sizeof(addr.sun_path))
+        return -1;
+    strcpy(addr.sun_path, path);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(fd < 0)
+        return -1;
+    unlink(path);
+    if(bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(fd, SOMAXCONN) != 0
+            || fcntl(fd, F_SETFL, O_NONBLOCK) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+/*
+ * Takes on a newly accepted connection.
+ * Returns the client, or NULL if the connection had to be closed.
+ */
+static CLIENT *newClient(SERVER *s, int fd) {
+    CLIENT *c = calloc(1, sizeof(CLIENT));
+    if(c == NULL || fcntl(fd, F_SETFL, O_NONBLOCK) != 0) {
+        fprintf(stderr, "Could not take on a client.\n");
+        close(fd);
+        free(c);
+        return NULL;
+    }
+    c->fd = fd;
+    c->turn = -1;
+    c->next = s->clients;
+    if(s->clients != NULL)
+        s->clients->prev = c;
+    s->clients = c;
+    return c;
+}
+/*
+ * Closes a client's connection and forgets it.
+ */
+static void dropClient(SERVER *s, int epoll, CLIENT *c) {
+    if(c->backlogged)
+        s->backlogged--;
+    if(c->prev != NULL)
+        c->prev->next = c->next;
+    else
+        s->clients = c->next;
+    if(c->next != NULL)
+        c->next->prev = c->prev;
+    epoll_ctl(epoll, EPOLL_CTL_DEL, c->fd, NULL);
+    close(c->fd);
+    free(c->in);
+    free(c->out);
+    free(c);
+}
+/*
+ * Reads what the client has sent, up to READ_BUDGET bytes; epoll is level
+ * triggered, so the rest wakes the server again.
+ * Returns 0 on success, or -1 if the connection failed.
+ */
+static int readClient(CLIENT *c) {
+    size_t budget = READ_BUDGET;
+    while(budget > 0 && !c->eof) {
+        if(c->inSize - c->inUsed < READ_CHUNK) {
+            c->inSize = c->inUsed + READ_CHUNK * 2;
+            c->in = realloc(c->in, c->inSize);
+            if(c->in == NULL)
+                return -1;
+        }
+        size_t room = c->inSize - c->inUsed;
+        ssize_t got = read(c->fd, c->in + c->inUsed, room < budget ? room : budget);
+        if(got > 0) {
+            c->inUsed += (size_t)got;
+            budget -= (size_t)got;
+        } else if(got == 0) {
+            c->eof = 1;     //Requests already read are still answered
+        } else if(errno == EAGAIN || errno == EWOULDBLOCK) {
+            break;
+        } else if(errno != EINTR) {
+            return -1;
+        }
+    }
+    return 0;
+}
+/*
+ * Sends as much of the queued responses as the socket will take.
+ * Returns 0 on success, or -1 if the client is gone.
+ */
+static int writeClient(CLIENT *c) {
+    while(c->outSent < c->outUsed) {
+        ssize_t sent = write(c->fd, c->out + c->outSent, c->outUsed - c->outSent);
+        if(sent > 0)
+            c->outSent += (size_t)sent;
+        else if(sent < 0 && errno == EINTR)
+            continue;
+        else if(sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            return 0;
+        else
+            return -1;
+    }
+    c->outSent = 0;
+    c->outUsed = 0;
+    return 0;
+}
+/*
+ * Gives the client a turn: handles a share of its whole requests if nothing
+ * is waiting to be sent, and sends what the socket will take.
+ * Returns 0 while the client stays connected, or -1 once it should be
+ * closed: after a failure, or once everything it asked for has been sent.
+ */
+static int serveClient(SERVER *s, CLIENT *c) {
+    c->turn = s->turn;
+    if(c->outSent == c->outUsed)
+        handleRequests(s, c);
+    if(c->outSent < c->outUsed && writeClient(c) != 0)
+        return -1;
+    if(c->outSent < c->outUsed)
+        return 0;
+    return c->closing || (c->eof && !c->more) ? -1 : 0;
+}
+/*
+ * Closes the client if it is not alive, and otherwise brings its events and
+ * its place in the backlog up to date.
+ */
+static void settleClient(SERVER *s, int epoll, CLIENT *c, int alive) {
+    if(!alive || watch(epoll, c) != 0) {
+        dropClient(s, epoll, c);
+        return;
+    }
+    int backlogged = c->more && c->outSent == c->outUsed;
+    s->backlogged += backlogged - c->backlogged;
+    c->backlogged = backlogged;
+}
+/*
+ * Handles the whole requests read from the client so far, up to TURN_BUDGET
+ * addresses' worth, queueing their responses. A request that is too large
+ * marks the client for closing.
+ */
+static void handleRequests(SERVER *s, CLIENT *c) {
+    size_t pos = 0;
+    long budget = TURN_BUDGET;
+    c->more = 0;
+    while(!c->closing && c->inUsed - pos >= sizeof(PROTO_HEADER)) {
+        PROTO_HEADER h;
+        memcpy(&h, c->in + pos, sizeof(h));
+        if(h.count > PROTO_MAX_BATCH) {
+            fprintf(stderr, "A request of %u addresses is too large; closing its connection.\n", h.count);
+            c->closing = 1;
+            break;
+        }
+        size_t size = sizeof(PROTO_HEADER) + requestSize(&h);
+        if(c->inUsed - pos < size)
+            break;
+        if(budget <= 0) {
+            c->more = 1;
+            break;
+        }
+        respond(s, c, &h, c->in + pos + sizeof(PROTO_HEADER));
+        pos += size;
+        budget -= h.count > 0 ? (long)h.count : 1;
+    }
+    memmove(c->in, c->in + pos, c->inUsed - pos);
+    c->inUsed -= pos;
+}
+/*
+ * Returns the size of the payload that follows a request's header.
+ */
+static size_t requestSize(const PROTO_HEADER *h) {
+    return h->op == PROTO_TRANSLATE || h->op == PROTO_READ ? sizeof(uint32_t) * h->count : 0;
+}
+/*
+ * Carries out one request and queues its response.
+ */
+static void respond(SERVER *s, CLIENT *c, const PROTO_HEADER *h, const unsigned char *payload) {
+    PROTO_HEADER reply = {h->op, PROTO_OK, h->instance, 0};
+    if(h->instance >= s->numInstances) {
+        reply.status = PROTO_BAD_REQUEST;
+        appendOut(c, &reply, sizeof(reply));
+        return;
+    }
+    VMM_CTX **ctx = &s->instances[h->instance];
+    switch(h->op) {
+    case PROTO_TRANSLATE:
+    case PROTO_READ: {
+        unsigned int *vaddrs = malloc(sizeof(unsigned int) * (h->count > 0 ? h->count : 1));
+        if(vaddrs == NULL) {
+            reply.status = PROTO_BAD_REQUEST;
+            break;
+        }
+        memcpy(vaddrs, payload, sizeof(uint32_t) * h->count);  //The payload may not be aligned
+        size_t made = vmm_translate_batch(*ctx, vaddrs, h->count, s->paddrs, h->op == PROTO_READ ? s->values : NULL);
+        free(vaddrs);
+        reply.count = (uint32_t)made;
+        if(made < h->count)
+            reply.status = PROTO_BAD_ADDRESS;
+        appendOut(c, &reply, sizeof(reply));
+        appendOut(c, s->paddrs, sizeof(uint32_t) * made);
+        if(h->op == PROTO_READ)
+            appendOut(c, s->values, made);
+        return;
+    }
+    case PROTO_STATS: {
+        VMM_STATS stats;
+        vmm_get_stats(*ctx, &stats);
+        const long *counters = (const long *)&stats;
+        reply.count = sizeof(VMM_STATS)/sizeof(long);
+        appendOut(c, &reply, sizeof(reply));
+        for(uint32_t i=0; i<reply.count; i++) {
+            int64_t counter = counters[i];
+            appendOut(c, &counter, sizeof(counter));
+        }
+        return;
+    }
+    case PROTO_RESET: {
+        VMM_CTX *fresh = vmm_create(&s->configs[h->instance]);
+        if(fresh == NULL) {     //Keeps the old instance
+            reply.status = PROTO_BAD_REQUEST;
+            break;
+        }
+        vmm_destroy(*ctx);
+        *ctx = fresh;
+        break;
+    }
+    default:
+        reply.status = PROTO_BAD_REQUEST;
+    }
+    appendOut(c, &reply, sizeof(reply));
+}
+static void appendOut(CLIENT *c, const void *data, size_t size) {
+    if(c->outUsed + size > c->outSize) {
+        c->outSize = (c->outUsed + size) * 2;
+        c->out = realloc(c->out, c->outSize);
+        if(c->out == NULL) {
+            fprintf(stderr, "Could not queue a response of %zu bytes.\n", size);
+            exit(-3);
+        }
+    }
+    memcpy(c->out + c->outUsed, data, size);
+    c->outUsed += size;
+}
+/*
+ * Registers(or updates) the events the client is waited on for: writable
+ * while there is a response left to send, and otherwise readable unless it
+ * has requests left over or will send no more.
+ * Returns 0 on success, or -1 on failure.
+ */
+static int watch(int epoll, CLIENT *c) {
+    struct epoll_event event;
+    if(c->outSent < c->outUsed)
+        event.events = EPOLLOUT;
+    else
+        event.events = c->more || c->eof || c->closing ? 0 : EPOLLIN;
+    event.data.ptr = c;
+    if(epoll_ctl(epoll, EPOLL_CTL_MOD, c->fd, &event) == 0)
+        return 0;
+    return errno == ENOENT && epoll_ctl(epoll, EPOLL_CTL_ADD, c->fd, &event) == 0 ? 0 : -1;
+}
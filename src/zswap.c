@@ -0,0 +1,376 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <assert.h>
+#include "zswap.h"
+
+#define MIN_MATCH 4                 //Shortest match worth encoding
+#define MAX_OFFSET 0xFFFF           //Matches are addressed with 2 bytes
+#define HASH_BITS 12
+#define HASH_SIZE (1 << HASH_BITS)
+
+/*
+ * One compressed page held in the pool. Entries are kept on a list from
+ * newest(head) to oldest(tail) so the pool can evict in FIFO order.
+ */
+typedef struct zswap_entry ZSWAP_ENTRY;
+struct zswap_entry {
+    int pageNum;
+    int dirty;                      //Not yet written back to swap
+    size_t size;
+    unsigned char *data;
+    ZSWAP_ENTRY *prev, *next;
+};
+
+struct zswap {
+    size_t poolSize;
+    int numPages;
+    unsigned int pageSize;
+    ZSWAP_ENTRY **byPage;           //Entry held for each page number, or NULL
+    ZSWAP_ENTRY *head, *tail;
+    unsigned char *scratch;         //Room to compress one page into
+    char *spill;                    //Room to decompress an evicted dirty page into
+    void (*writeBack)(void *, int, const char *);
+    void *arg;                      //Passed to writeBack
+    ZSWAP_STATS stats;
+};
+
+static void addEntry(ZSWAP *z, int pageNum, int dirty, const unsigned char *data, size_t size);
+static void unlinkEntry(ZSWAP *z, ZSWAP_ENTRY *e);
+static void dropEntry(ZSWAP *z, ZSWAP_ENTRY *e);
+static void evictEntry(ZSWAP *z, ZSWAP_ENTRY *e);
+
+/*
+ * Creates a pool of poolSize bytes for pages numbered below numPages. Dirty
+ * pages evicted from the pool are passed to writeBack, along with arg.
+ */
+ZSWAP *newZSWAP(size_t poolSize, int numPages, unsigned int pageSize,
+        void (*writeBack)(void *, int, const char *), void *arg) {
+    ZSWAP *z = malloc(sizeof(ZSWAP));
+    assert(z != 0);
+
+    z->poolSize = poolSize;
+    z->numPages = numPages;
+    z->pageSize = pageSize;
+    z->byPage = calloc(numPages, sizeof(ZSWAP_ENTRY *));
+    assert(z->byPage != 0);
+    z->head = NULL;
+    z->tail = NULL;
+    z->scratch = malloc(pageSize);
+    assert(z->scratch != 0);
+    z->spill = malloc(pageSize);
+    assert(z->spill != 0);
+    z->writeBack = writeBack;
+    z->arg = arg;
+    memset(&z->stats, 0, sizeof(ZSWAP_STATS));
+    return z;
+}
+/*
+ * Compresses the given page into the pool, evicting the oldest entries if
+ * there is not enough room. Pages that do not shrink are rejected; a dirty
+ * page that is rejected must be written back by the caller.
+ * Returns 1 if the page was stored, 0 if not.
+ */
+int storeZSWAP(ZSWAP *z, int pageNum, const char *data, int dirty) {
+    if(z->byPage[pageNum] != NULL)
+        dropEntry(z, z->byPage[pageNum]);   //Stale copy
+
+    size_t size = compressPage((const unsigned char *)data, z->pageSize, z->scratch, z->pageSize - 1);
+    if(size == 0 || size > z->poolSize) {
+        z->stats.rejects++;
+        return 0;
+    }
+    while(z->stats.poolUsed + size > z->poolSize)
+        evictEntry(z, z->tail);
+
+    addEntry(z, pageNum, dirty, z->scratch, size);
+    z->stats.stores++;
+    z->stats.bytesIn += z->pageSize;
+    z->stats.bytesOut += size;
+    return 1;
+}
+/*
+ * Looks for the given page in the pool. If it is there, it is decompressed
+ * into data and removed from the pool, and dirty is set if it was never
+ * written back(so data is now its only copy).
+ * Returns 1 on a pool hit, 0 otherwise.
+ */
+int loadZSWAP(ZSWAP *z, int pageNum, char *data, int *dirty) {
+    ZSWAP_ENTRY *e = z->byPage[pageNum];
+    if(e == NULL)
+        return 0;
+    size_t got = decompressPage(e->data, e->size, (unsigned char *)data, z->pageSize);
+    if(got != z->pageSize)
+        fprintf(stderr, "Error in loadZSWAP; page %d decompressed to %zu bytes.\n", pageNum, got);
+    *dirty = e->dirty;
+    dropEntry(z, e);
+    z->stats.hits++;
+    return 1;
+}
+/*
+ * Decompresses the given page into data if the pool holds it dirty, leaving
+ * it in the pool.
+ * Returns 1 if it did, 0 if the pool holds no dirty copy of the page.
+ */
+int peekDirtyZSWAP(ZSWAP *z, int pageNum, char *data) {
+    ZSWAP_ENTRY *e = z->byPage[pageNum];
+    if(e == NULL || !e->dirty)
+        return 0;
+    if(decompressPage(e->data, e->size, (unsigned char *)data, z->pageSize) != z->pageSize)
+        fprintf(stderr, "Error in peekDirtyZSWAP; page %d did not decompress.\n", pageNum);
+    return 1;
+}
+/*
+ * Forgets any copy of the given page held in the pool, without writing it
+ * back.
+ */
+void invalidateZSWAP(ZSWAP *z, int pageNum) {
+    if(z->byPage[pageNum] != NULL)
+        dropEntry(z, z->byPage[pageNum]);
+}
+void statsZSWAP(ZSWAP *z, ZSWAP_STATS *stats) {
+    *stats = z->stats;
+}
+/*
+ * Writes the pool(oldest entry first) and its statistics to a checkpoint.
+ */
+void saveZSWAP(ZSWAP *z, FILE *fp) {
+    int64_t count = 0;
+    for(ZSWAP_ENTRY *e = z->head; e != NULL; e = e->next)
+        count++;
+    writeSnapshotI64(fp, count);
+    for(ZSWAP_ENTRY *e = z->tail; e != NULL; e = e->prev) {
+        writeSnapshotI32(fp, e->pageNum);
+        writeSnapshotI32(fp, e->dirty);
+        writeSnapshotI64(fp, (int64_t)e->size);
+        writeSnapshotBytes(fp, e->data, e->size);
+    }
+    writeSnapshotI64(fp, z->stats.stores);
+    writeSnapshotI64(fp, z->stats.rejects);
+    writeSnapshotI64(fp, z->stats.hits);
+    writeSnapshotI64(fp, z->stats.evictions);
+    writeSnapshotI64(fp, z->stats.writeBacks);
+    writeSnapshotI64(fp, z->stats.bytesIn);
+    writeSnapshotI64(fp, z->stats.bytesOut);
+}
+/*
+ * Refills an empty pool from a checkpoint written by saveZSWAP.
+ * Returns 0 on success, or -1 if the checkpoint does not fit this pool.
+ */
+int restoreZSWAP(ZSWAP *z, SNAPSHOT_READER *r) {
+    int64_t count = readSnapshotI64(r);
+    for(int64_t i=0; i<count && !r->error; i++) {
+        int pageNum = readSnapshotI32(r);
+        int dirty = readSnapshotI32(r);
+        int64_t size = readSnapshotI64(r);
+        if(pageNum < 0 || pageNum >= z->numPages || size <= 0 || size >= z->pageSize
+                || z->byPage[pageNum] != NULL || z->stats.poolUsed + size > z->poolSize)
+            return -1;
+        const unsigned char *data = readSnapshotBytes(r, (size_t)size);
+        if(data == NULL)
+            return -1;
+        addEntry(z, pageNum, dirty != 0, data, (size_t)size);
+    }
+    z->stats.stores = readSnapshotI64(r);
+    z->stats.rejects = readSnapshotI64(r);
+    z->stats.hits = readSnapshotI64(r);
+    z->stats.evictions = readSnapshotI64(r);
+    z->stats.writeBacks = readSnapshotI64(r);
+    z->stats.bytesIn = readSnapshotI64(r);
+    z->stats.bytesOut = readSnapshotI64(r);
+    return r->error ? -1 : 0;
+}
+void freeZSWAP(ZSWAP *z) {
+    while(z->head)
+        dropEntry(z, z->head);
+    free(z->byPage);
+    free(z->scratch);
+    free(z->spill);
+    free(z);
+}
+
+/*
+ * Adds a compressed page to the pool as its newest entry.
+ */
+static void addEntry(ZSWAP *z, int pageNum, int dirty, const unsigned char *data, size_t size) {
+    ZSWAP_ENTRY *e = malloc(sizeof(ZSWAP_ENTRY));
+    assert(e != 0);
+    e->data = malloc(size);
+    assert(e->data != 0);
+    memcpy(e->data, data, size);
+    e->pageNum = pageNum;
+    e->dirty = dirty;
+    e->size = size;
+    e->prev = NULL;
+    e->next = z->head;
+    if(z->head)
+        z->head->prev = e;
+    else
+        z->tail = e;
+    z->head = e;
+    z->byPage[pageNum] = e;
+    z->stats.poolUsed += size;
+}
+static void unlinkEntry(ZSWAP *z, ZSWAP_ENTRY *e) {
+    if(e->prev)
+        e->prev->next = e->next;
+    else
+        z->head = e->next;
+    if(e->next)
+        e->next->prev = e->prev;
+    else
+        z->tail = e->prev;
+}
+static void dropEntry(ZSWAP *z, ZSWAP_ENTRY *e) {
+    unlinkEntry(z, e);
+    z->byPage[e->pageNum] = NULL;
+    z->stats.poolUsed -= e->size;
+    free(e->data);
+    free(e);
+}
+/*
+ * Drops an entry to make room, first handing it to the write-back function
+ * if it is dirty.
+ */
+static void evictEntry(ZSWAP *z, ZSWAP_ENTRY *e) {
+    if(e->dirty) {
+        if(decompressPage(e->data, e->size, (unsigned char *)z->spill, z->pageSize) != z->pageSize)
+            fprintf(stderr, "Error in evictEntry; page %d did not decompress.\n", e->pageNum);
+        z->writeBack(z->arg, e->pageNum, z->spill);
+        z->stats.writeBacks++;
+    }
+    dropEntry(z, e);
+    z->stats.evictions++;
+}
+
+/*
+ * The codec is a small LZ77 variant in the style of LZ4. The input is a list
+ * of sequences, each made of a token byte, literal bytes and a match. The
+ * high nibble of the token is the literal count and the low nibble is the
+ * match length minus MIN_MATCH; a nibble of 15 is followed by extra length
+ * bytes(255 meaning "keep adding"). A match is a 2 byte little endian offset
+ * back into the output. The last sequence holds only literals.
+ */
+static uint32_t read32(const unsigned char *p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+static unsigned int hash32(uint32_t v) {
+    return (v * 2654435761u) >> (32 - HASH_BITS);
+}
+static size_t writeLength(unsigned char *dst, size_t op, size_t capacity, size_t len) {
+    while(len >= 255) {
+        if(op >= capacity)
+            return 0;
+        dst[op++] = 255;
+        len -= 255;
+    }
+    if(op >= capacity)
+        return 0;
+    dst[op++] = (unsigned char)len;
+    return op;
+}
+static size_t writeSequence(unsigned char *dst, size_t op, size_t capacity,
+        const unsigned char *literals, size_t litLen, size_t offset, size_t matchLen) {
+    size_t tokenPos = op;
+    if(op >= capacity)
+        return 0;
+    op++;
+    unsigned char token = (unsigned char)((litLen >= 15 ? 15 : litLen) << 4);
+    if(litLen >= 15 && (op = writeLength(dst, op, capacity, litLen - 15)) == 0)
+        return 0;
+    if(op + litLen > capacity)
+        return 0;
+    memcpy(dst + op, literals, litLen);
+    op += litLen;
+    if(matchLen != 0) {
+        size_t code = matchLen - MIN_MATCH;
+        token |= (unsigned char)(code >= 15 ? 15 : code);
+        if(op + 2 > capacity)
+            return 0;
+        dst[op++] = (unsigned char)(offset & 0xFF);
+        dst[op++] = (unsigned char)(offset >> 8);
+        if(code >= 15 && (op = writeLength(dst, op, capacity, code - 15)) == 0)
+            return 0;
+    }
+    dst[tokenPos] = token;
+    return op;
+}
+/*
+ * Compresses size bytes of src into dst.
+ * Returns the compressed size, or 0 if it would not fit in capacity bytes.
+ */
+size_t compressPage(const unsigned char *src, size_t size, unsigned char *dst, size_t capacity) {
+    uint32_t table[HASH_SIZE];  //Position+1 of the last occurrence of each hash
+    memset(table, 0, sizeof(table));
+
+    size_t ip = 0, anchor = 0, op = 0;
+    while(ip + MIN_MATCH <= size) {
+        uint32_t seq = read32(src + ip);
+        unsigned int h = hash32(seq);
+        size_t candidate = table[h];
+        table[h] = (uint32_t)(ip + 1);
+        if(candidate == 0 || ip - (candidate-1) > MAX_OFFSET || read32(src + candidate - 1) != seq) {
+            ip++;
+            continue;
+        }
+        candidate--;
+        size_t len = MIN_MATCH;
+        while(ip + len < size && src[candidate + len] == src[ip + len])
+            len++;
+        op = writeSequence(dst, op, capacity, src + anchor, ip - anchor, ip - candidate, len);
+        if(op == 0)
+            return 0;
+        ip += len;
+        anchor = ip;
+    }
+    if(anchor < size || op == 0)
+        op = writeSequence(dst, op, capacity, src + anchor, size - anchor, 0, 0);
+    return op;
+}
+static int readLength(const unsigned char *src, size_t *ip, size_t size, size_t *len) {
+    unsigned char b;
+    do {
+        if(*ip >= size)
+            return -1;
+        b = src[(*ip)++];
+        *len += b;
+    } while(b == 255);
+    return 0;
+}
+/*
+ * Expands size bytes of compressed src into dst.
+ * Returns the number of bytes produced, or 0 if the input is malformed.
+ */
+size_t decompressPage(const unsigned char *src, size_t size, unsigned char *dst, size_t capacity) {
+    size_t ip = 0, op = 0;
+    while(ip < size) {
+        unsigned char token = src[ip++];
+        size_t litLen = token >> 4;
+        if(litLen == 15 && readLength(src, &ip, size, &litLen) != 0)
+            return 0;
+        if(ip + litLen > size || op + litLen > capacity)
+            return 0;
+        memcpy(dst + op, src + ip, litLen);
+        ip += litLen;
+        op += litLen;
+        if(ip >= size)
+            break;  //Final literal-only sequence
+
+        if(ip + 2 > size)
+            return 0;
+        size_t offset = src[ip] | ((size_t)src[ip+1] << 8);
+        ip += 2;
+        size_t matchLen = token & 0x0F;
+        if(matchLen == 15 && readLength(src, &ip, size, &matchLen) != 0)
+            return 0;
+        matchLen += MIN_MATCH;
+        if(offset == 0 || offset > op || op + matchLen > capacity)
+            return 0;
+        for(size_t i=0; i<matchLen; i++, op++)  //Byte by byte, since matches may overlap
+            dst[op] = dst[op - offset];
+    }
+    return op;
+}
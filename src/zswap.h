@@ -0,0 +1,39 @@
+#ifndef ZSWAP_H
+#define ZSWAP_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include "snapshot.h"
+
+/*
+ * A compressed in-RAM swap tier. Pages evicted from the frames are
+ * compressed into a fixed-size pool, and a later fault on one of them is
+ * served from the pool instead of the backing store. The pool evicts its
+ * oldest entry when a new one does not fit. A dirty page(one not yet written
+ * back to swap) is kept only in the pool, and is handed to the write-back
+ * function when it is evicted.
+ */
+typedef struct zswap ZSWAP;
+
+typedef struct zswap_stats {
+    long stores, rejects, hits, evictions;
+    long writeBacks;            //Evicted dirty entries handed to the write-back function
+    long bytesIn, bytesOut;     //Uncompressed/compressed bytes of every accepted store
+    size_t poolUsed;            //Compressed bytes currently held
+} ZSWAP_STATS;
+
+extern ZSWAP *newZSWAP(size_t poolSize, int numPages, unsigned int pageSize,
+        void (*writeBack)(void *, int, const char *), void *arg);
+extern int storeZSWAP(ZSWAP *z, int pageNum, const char *data, int dirty);
+extern int loadZSWAP(ZSWAP *z, int pageNum, char *data, int *dirty);
+extern int peekDirtyZSWAP(ZSWAP *z, int pageNum, char *data);
+extern void invalidateZSWAP(ZSWAP *z, int pageNum);
+extern void statsZSWAP(ZSWAP *z, ZSWAP_STATS *stats);
+extern void saveZSWAP(ZSWAP *z, FILE *fp);
+extern int restoreZSWAP(ZSWAP *z, SNAPSHOT_READER *r);
+extern void freeZSWAP(ZSWAP *z);
+
+extern size_t compressPage(const unsigned char *src, size_t size, unsigned char *dst, size_t capacity);
+extern size_t decompressPage(const unsigned char *src, size_t size, unsigned char *dst, size_t capacity);
+
+#endif